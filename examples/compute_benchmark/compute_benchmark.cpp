@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "ComputePrimitives.h"
+#include "Device.h"
+#include "Instance.h"
+#include "QueueFlags.h"
+
+namespace
+{
+  const unsigned int ITERATIONS = 5;
+
+  // Device local buffers alive at once at the largest size: values, flags,
+  // output, keys and indices, plus the scratch keys and values of
+  // ComputePrimitives::Reserve
+  const unsigned int DEVICE_BUFFERS_PER_ELEMENT = 7;
+
+  double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+  }
+
+  /**
+   * @brief Best wall time of a few submissions, setup runs untimed before each
+   */
+  double timeBest(ComputePrimitives& primitives, const std::function<void()>& setup, const std::function<void(VkCommandBuffer)>& record) {
+    double best = 1e30;
+    for (unsigned int i = 0; i < ITERATIONS; i++)
+    {
+      if (setup) {
+        setup();
+      }
+      auto start = std::chrono::high_resolution_clock::now();
+      primitives.Execute(record);
+      best = std::min(best, millisecondsSince(start));
+    }
+    return best;
+  }
+
+  void report(const char* name, uint32_t count, double milliseconds, bool correct) {
+    std::printf("  %-14s %10.3f ms  %10.1f Melem/s  %s\n", name, milliseconds, count / 1e6 / (milliseconds / 1e3),
+      correct ? "ok" : "MISMATCH");
+  }
+
+  /**
+   * @brief Largest element count the device can hold, limited by the storage
+   *        buffer range and the device local heap budget. Upload and Download
+   *        add a full size staging buffer, which counts against the same heap
+   *        when host visible memory shares it, as on UMA drivers.
+   */
+  uint64_t maxElementCount(Device* device) {
+    const VkPhysicalDeviceLimits& limits = device->GetProperties().limits;
+    uint64_t maxCount = limits.maxStorageBufferRange / sizeof(uint32_t);
+
+    std::vector<HeapBudget> heaps = device->GetMemoryBudget()->GetHeapBudgets();
+    VkDeviceSize deviceLocalBudget = 0;
+    uint32_t deviceLocalHeap = 0;
+    for (uint32_t i = 0; i < heaps.size(); i++)
+    {
+      if (heaps[i].deviceLocal && heaps[i].budget > deviceLocalBudget) {
+        deviceLocalBudget = heaps[i].budget;
+        deviceLocalHeap = i;
+      }
+    }
+
+    unsigned int buffersPerElement = DEVICE_BUFFERS_PER_ELEMENT;
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = device->GetMemoryProperties();
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+      if ((memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        memoryProperties.memoryTypes[i].heapIndex == deviceLocalHeap) {
+        buffersPerElement++;
+        break;
+      }
+    }
+    return std::min<uint64_t>(maxCount, deviceLocalBudget / (buffersPerElement * sizeof(uint32_t)));
+  }
+} // namespace
+
+int main(int argc, char const *argv[])
+{
+  // Headless, no surface or swap chain needed
+  Instance* instance = new Instance("Compute Benchmark", 0, nullptr);
+  instance->PickPhysicalDevice({}, QueueFlagBit::ComputeBit, VK_NULL_HANDLE);
+  Device* device = instance->CreateDevice(QueueFlagBit::ComputeBit, {});
+
+  uint64_t maxCount = maxElementCount(device);
+  if (argc > 1) {
+    maxCount = std::min<uint64_t>(maxCount, std::strtoull(argv[1], nullptr, 10));
+  }
+
+  std::vector<uint32_t> counts;
+  for (unsigned long long count : { 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull })
+  {
+    if (count <= maxCount) {
+      counts.push_back(static_cast<uint32_t>(count));
+    } else {
+      std::printf("Skipping %llu elements, more than the device can hold\n", count);
+    }
+  }
+  if (counts.empty()) {
+    std::printf("No benchmark size fits on the device\n");
+    delete device;
+    delete instance;
+    return 1;
+  }
+
+  ComputePrimitives* computePrimitives = new ComputePrimitives(device);
+  ComputePrimitives& primitives = *computePrimitives;
+  primitives.Reserve(counts.back());
+
+  std::printf("Compute primitives benchmark on %s, %s, best of %u runs\n",
+    device->GetProperties().deviceName, primitives.UsesSubgroups() ? "subgroup arithmetic" : "shared memory scans", ITERATIONS);
+  std::printf("Tile size %u, radix tile size %u\n\n", primitives.GetTileSize(), primitives.GetRadixTileSize());
+
+  bool allCorrect = true;
+  for (uint32_t count : counts)
+  {
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<uint32_t> valueDistribution(0, 255);
+    std::uniform_int_distribution<uint32_t> flagDistribution(0, 1);
+    std::uniform_int_distribution<uint32_t> keyDistribution;
+
+    std::vector<uint32_t> values(count), flags(count), keys(count), indices(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      values[i] = valueDistribution(random);
+      flags[i] = flagDistribution(random);
+      keys[i] = keyDistribution(random);
+      indices[i] = i;
+    }
+
+    const VkDeviceSize size = count * sizeof(uint32_t);
+    ComputeBuffer valueBuffer = primitives.CreateBuffer(size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    ComputeBuffer flagBuffer = primitives.CreateBuffer(size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    ComputeBuffer outputBuffer = primitives.CreateBuffer(size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    ComputeBuffer keyBuffer = primitives.CreateBuffer(size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    ComputeBuffer indexBuffer = primitives.CreateBuffer(size, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    ComputeBuffer resultBuffer = primitives.CreateBuffer(sizeof(uint32_t),
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    primitives.Upload(valueBuffer, values.data(), size);
+    primitives.Upload(flagBuffer, flags.data(), size);
+
+    std::printf("%u elements\n", count);
+    std::vector<uint32_t> result(count);
+    bool correct;
+
+    // --- Reduce ---
+    double reduceTime = timeBest(primitives, nullptr, [&](VkCommandBuffer commandBuffer) {
+      primitives.RecordReduce(commandBuffer, valueBuffer, resultBuffer, count);
+    });
+    uint32_t sum;
+    primitives.Download(resultBuffer, &sum, sizeof(uint32_t));
+    correct = sum == ComputeReference::Reduce(values);
+    report("reduce", count, reduceTime, correct);
+    allCorrect = allCorrect && correct;
+
+    // --- Exclusive scan ---
+    double scanTime = timeBest(primitives, nullptr, [&](VkCommandBuffer commandBuffer) {
+      primitives.RecordExclusiveScan(commandBuffer, valueBuffer, outputBuffer, count);
+    });
+    primitives.Download(outputBuffer, result.data(), size);
+    correct = result == ComputeReference::ExclusiveScan(values);
+    report("exclusive scan", count, scanTime, correct);
+    allCorrect = allCorrect && correct;
+
+    // --- Compact ---
+    double compactTime = timeBest(primitives, nullptr, [&](VkCommandBuffer commandBuffer) {
+      primitives.RecordCompact(commandBuffer, valueBuffer, flagBuffer, outputBuffer, resultBuffer, count);
+    });
+    std::vector<uint32_t> expected = ComputeReference::Compact(values, flags);
+    uint32_t compactedCount;
+    primitives.Download(resultBuffer, &compactedCount, sizeof(uint32_t));
+    correct = compactedCount == expected.size();
+    if (correct) {
+      primitives.Download(outputBuffer, result.data(), size);
+      correct = std::equal(expected.begin(), expected.end(), result.begin());
+    }
+    report("compact", count, compactTime, correct);
+    allCorrect = allCorrect && correct;
+
+    // --- Radix sort ---
+    double sortTime = timeBest(primitives, [&]() {
+      primitives.Upload(keyBuffer, keys.data(), size);
+      primitives.Upload(indexBuffer, indices.data(), size);
+    }, [&](VkCommandBuffer commandBuffer) {
+      primitives.RecordRadixSort(commandBuffer, keyBuffer, indexBuffer, count);
+    });
+    std::vector<uint32_t> sortedKeys = keys;
+    std::vector<uint32_t> sortedIndices = indices;
+    ComputeReference::RadixSort(sortedKeys, sortedIndices);
+    primitives.Download(keyBuffer, result.data(), size);
+    correct = result == sortedKeys;
+    primitives.Download(indexBuffer, result.data(), size);
+    correct = correct && result == sortedIndices;
+    report("radix sort", count, sortTime, correct);
+    allCorrect = allCorrect && correct;
+
+    std::printf("\n");
+
+    primitives.DestroyBuffer(valueBuffer);
+    primitives.DestroyBuffer(flagBuffer);
+    primitives.DestroyBuffer(outputBuffer);
+    primitives.DestroyBuffer(keyBuffer);
+    primitives.DestroyBuffer(indexBuffer);
+    primitives.DestroyBuffer(resultBuffer);
+  }
+
+  if (!allCorrect) {
+    std::printf("Some results did not match the CPU reference\n");
+  }
+
+  delete computePrimitives;
+  delete device;
+  delete instance;
+  return allCorrect ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "RadixSort.h"
+#include "RenderQueue.h"
+
+namespace
+{
+  const unsigned int PIPELINE_COUNT = 16;
+  const unsigned int DESCRIPTOR_SET_COUNT = 4;
+  const unsigned int MATERIAL_COUNT = 512;
+  const unsigned int MESH_COUNT = 1024;
+  const unsigned int ITERATIONS = 5;
+
+  double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+  }
+
+  /**
+   * @brief Fill a queue with a synthetic scene: each material belongs to one
+   *        pipeline and a handful of meshes, draws are submitted in random
+   *        order as a scene traversal would produce them.
+   */
+  void buildScene(RenderQueue& queue, size_t drawCount, std::mt19937& random) {
+    std::uniform_int_distribution<uint32_t> materialDistribution(0, MATERIAL_COUNT - 1);
+    std::uniform_int_distribution<uint32_t> meshDistribution(0, 7);
+    std::uniform_int_distribution<uint32_t> descriptorSetDistribution(0, DESCRIPTOR_SET_COUNT - 1);
+    std::uniform_real_distribution<float> depthDistribution(0.0f, 1.0f);
+
+    for (size_t i = 0; i < drawCount; i++)
+    {
+      uint32_t material = materialDistribution(random);
+
+      DrawItem item;
+      item.pipeline = material % PIPELINE_COUNT;
+      item.descriptorSet = descriptorSetDistribution(random);
+      item.material = material;
+      item.mesh = (material * 8 + meshDistribution(random)) % MESH_COUNT;
+      item.depth = depthDistribution(random);
+      item.instanceIndex = static_cast<uint32_t>(i);
+      queue.Submit(item);
+    }
+  }
+
+  double timeRadixSort(const std::vector<uint64_t>& keys, unsigned int threadCount) {
+    double best = 1e30;
+    for (unsigned int i = 0; i < ITERATIONS; i++)
+    {
+      std::vector<uint64_t> sortKeys = keys;
+      std::vector<uint32_t> values(keys.size());
+      for (size_t j = 0; j < values.size(); j++)
+      {
+        values[j] = static_cast<uint32_t>(j);
+      }
+
+      auto start = std::chrono::high_resolution_clock::now();
+      RadixSort(sortKeys, values, threadCount);
+      best = std::min(best, millisecondsSince(start));
+
+      if (!std::is_sorted(sortKeys.begin(), sortKeys.end())) {
+        std::printf("  radix sort produced unsorted output!\n");
+      }
+    }
+    return best;
+  }
+
+  double timeStdSort(const std::vector<uint64_t>& keys) {
+    double best = 1e30;
+    for (unsigned int i = 0; i < ITERATIONS; i++)
+    {
+      std::vector<uint64_t> sortKeys = keys;
+      auto start = std::chrono::high_resolution_clock::now();
+      std::sort(sortKeys.begin(), sortKeys.end());
+      best = std::min(best, millisecondsSince(start));
+    }
+    return best;
+  }
+} // namespace
+
+int main()
+{
+  const size_t drawCounts[] = { 10000, 100000, 1000000 };
+  const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::printf("Render queue benchmark, %u hardware threads, best of %u runs\n\n", hardwareThreads, ITERATIONS);
+
+  for (size_t drawCount : drawCounts)
+  {
+    std::mt19937 random(1234);
+
+    RenderQueue queue;
+    for (unsigned int i = 0; i < PIPELINE_COUNT; i++)
+    {
+      queue.RegisterPipeline(VK_NULL_HANDLE, VK_NULL_HANDLE);
+    }
+    for (unsigned int i = 0; i < DESCRIPTOR_SET_COUNT; i++)
+    {
+      queue.RegisterDescriptorSet(VK_NULL_HANDLE);
+    }
+    for (unsigned int i = 0; i < MATERIAL_COUNT; i++)
+    {
+      queue.RegisterMaterial(VK_NULL_HANDLE);
+    }
+    for (unsigned int i = 0; i < MESH_COUNT; i++)
+    {
+      queue.RegisterMesh(VK_NULL_HANDLE, VK_NULL_HANDLE, 36);
+    }
+
+    buildScene(queue, drawCount, random);
+
+    // --- Sort throughput ---
+    std::vector<uint64_t> keys(drawCount);
+    std::uniform_int_distribution<uint64_t> keyDistribution;
+    for (auto& key : keys)
+    {
+      key = keyDistribution(random);
+    }
+    double singleThreaded = timeRadixSort(keys, 1);
+    double multiThreaded = timeRadixSort(keys, hardwareThreads);
+    double stdSort = timeStdSort(keys);
+
+    double queueSort = 1e30;
+    for (unsigned int i = 0; i < ITERATIONS; i++)
+    {
+      auto start = std::chrono::high_resolution_clock::now();
+      queue.Sort();
+      queueSort = std::min(queueSort, millisecondsSince(start));
+    }
+
+    double megaKeys = drawCount / 1e6;
+    std::printf("%zu draws\n", drawCount);
+    std::printf("  radix sort, 1 thread:    %8.3f ms  %8.1f Mkeys/s\n", singleThreaded, megaKeys / (singleThreaded / 1e3));
+    std::printf("  radix sort, %2u threads:  %8.3f ms  %8.1f Mkeys/s\n", hardwareThreads, multiThreaded, megaKeys / (multiThreaded / 1e3));
+    std::printf("  std::sort:               %8.3f ms  %8.1f Mkeys/s\n", stdSort, megaKeys / (stdSort / 1e3));
+    std::printf("  queue sort + batching:   %8.3f ms\n", queueSort);
+
+    // --- State change reduction ---
+    RenderQueueStats unsorted = queue.GetUnsortedStats();
+    RenderQueueStats sorted = queue.GetStats();
+    std::printf("  %-22s %10s %10s %10s %10s %10s\n", "", "draw calls", "pipelines", "sets", "meshes", "total");
+    std::printf("  %-22s %10zu %10zu %10zu %10zu %10zu\n", "submission order",
+      unsorted.drawCalls, unsorted.pipelineBinds, unsorted.descriptorSetBinds, unsorted.meshBinds, unsorted.StateChanges());
+    std::printf("  %-22s %10zu %10zu %10zu %10zu %10zu\n", "sorted + instanced",
+      sorted.drawCalls, sorted.pipelineBinds, sorted.descriptorSetBinds, sorted.meshBinds, sorted.StateChanges());
+    std::printf("  state changes reduced %.1fx, draw calls reduced %.1fx\n\n",
+      static_cast<double>(unsorted.StateChanges()) / std::max<size_t>(1, sorted.StateChanges()),
+      static_cast<double>(unsorted.drawCalls) / std::max<size_t>(1, sorted.drawCalls));
+  }
+
+  return 0;
+}
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <set>
+#include <vector>
+
+#include "Device.h"
+#include "Instance.h"
+#include "QueueFlags.h"
+#include "ResidencyManager.h"
+#include "ResidentBuffer.h"
+#include "ResidentImage.h"
+
+namespace
+{
+  const unsigned int BUFFER_COUNT = 16;
+  const VkDeviceSize BUFFER_SIZE = 4 << 20;
+  const unsigned int FRAMES = 8;
+  const unsigned int IMAGE_COUNT = 8;
+  const uint32_t IMAGE_SIZE = 1024;
+  const uint32_t IMAGE_MIP_LEVELS = 11;
+
+  bool check(bool condition, const char* what) {
+    std::printf("  %-62s %s\n", what, condition ? "ok" : "FAILED");
+    return condition;
+  }
+
+  /**
+   * @brief Eviction order with resources leaving and re-entering residency
+   *        between Touch calls. Uses stand-in resources with a heap limit of
+   *        zero, so every resource out of flight gets evicted.
+   */
+  bool checkLruOrder(Device* device, uint32_t heapIndex) {
+    ResidencyManager residency(device->GetMemoryBudget());
+    std::vector<char> evicted;
+    auto evictAs = [&evicted](char name) {
+      return [&evicted, name](VkDeviceSize) { evicted.push_back(name); return VkDeviceSize(0); };
+    };
+
+    ResidencyManager::ResourceId a = residency.Register(heapIndex, BUFFER_SIZE, evictAs('A'));
+    residency.Register(heapIndex, BUFFER_SIZE, evictAs('B'));
+    ResidencyManager::ResourceId c = residency.Register(heapIndex, BUFFER_SIZE, evictAs('C'));
+
+    // A drops out at frame 0 and comes back at frame 8, right before C is used
+    residency.SetResidentSize(a, 0);
+    for (unsigned int i = 0; i < FRAMES; i++)
+    {
+      residency.NextFrame();
+    }
+    residency.SetResidentSize(a, BUFFER_SIZE);
+    residency.Touch(c);
+
+    residency.NextFrame();
+    residency.SetHeapLimit(heapIndex, 0);
+    residency.Enforce();
+    bool correct = check(evicted == std::vector<char>{ 'B' }, "only the resource idle since frame 0 is evicted");
+
+    // Once A and C are out of flight they go, A first as it came back first
+    residency.NextFrame();
+    residency.NextFrame();
+    correct = check(evicted == std::vector<char>{ 'B', 'A', 'C' }, "re-resident resources are evicted in last use order") && correct;
+
+    return correct;
+  }
+
+  /**
+   * @brief Push the device local heap over a lowered limit and check the
+   *        idle buffers move to host memory with their contents
+   */
+  bool checkDemotion(Device* device, std::vector<ResidentBuffer*>& buffers) {
+    ResidencyManager* residency = device->GetResidencyManager();
+    MemoryBudget* budget = device->GetMemoryBudget();
+    uint32_t heapIndex = buffers[0]->GetDeviceLocalHeap();
+
+    budget->Update();
+    VkDeviceSize usageBefore = budget->GetHeapBudget(heapIndex).usage;
+    VkDeviceSize limit = usageBefore / 4 * 3;
+    residency->SetHeapLimit(heapIndex, limit);
+
+    // The second half of the buffers is used every frame, the first half never
+    for (unsigned int frame = 0; frame < FRAMES; frame++)
+    {
+      for (unsigned int i = BUFFER_COUNT / 2; i < BUFFER_COUNT; i++)
+      {
+        buffers[i]->Touch();
+      }
+      residency->NextFrame();
+    }
+
+    VkDeviceSize usageAfter = budget->GetHeapBudget(heapIndex).usage;
+    ResidencyStats stats = residency->GetStats();
+    std::printf("  heap %u usage %.1f MB -> %.1f MB, limit %.1f MB, %llu evictions\n", heapIndex,
+      usageBefore / 1048576.0, usageAfter / 1048576.0, limit / 1048576.0, static_cast<unsigned long long>(stats.evictions));
+
+    bool correct = check(usageAfter < usageBefore, "device local usage went down");
+    correct = check(usageAfter <= static_cast<VkDeviceSize>(limit * 0.95f), "device local usage is back under the high water mark") && correct;
+
+    bool hotResident = true;
+    for (unsigned int i = BUFFER_COUNT / 2; i < BUFFER_COUNT; i++)
+    {
+      hotResident = hotResident && buffers[i]->IsDeviceLocal();
+    }
+    correct = check(hotResident, "buffers used every frame stay device local") && correct;
+
+    bool contentsKept = true;
+    std::vector<uint32_t> contents(BUFFER_SIZE / sizeof(uint32_t));
+    for (unsigned int i = 0; i < BUFFER_COUNT; i++)
+    {
+      buffers[i]->Download(contents.data(), BUFFER_SIZE);
+      contentsKept = contentsKept && std::all_of(contents.begin(), contents.end(), [i](uint32_t value) { return value == i; });
+    }
+    correct = check(contentsKept, "demoted buffers keep their contents") && correct;
+
+    return correct;
+  }
+
+  /**
+   * @brief Fill every level with a value naming the image and the level
+   */
+  void uploadMips(ResidentImage* image, unsigned int imageIndex) {
+    for (uint32_t level = 0; level < image->GetMipLevels(); level++)
+    {
+      std::vector<uint32_t> texels(image->GetMipSize(level) / sizeof(uint32_t), imageIndex << 8 | level);
+      image->Upload(level, texels.data());
+    }
+  }
+
+  /**
+   * @brief Push the device local heap over a lowered limit and check the idle
+   *        textures give up their top mips, keeping the levels left
+   */
+  bool checkMipDemotion(Device* device) {
+    ResidencyManager* residency = device->GetResidencyManager();
+    MemoryBudget* budget = device->GetMemoryBudget();
+
+    std::vector<ResidentImage*> images;
+    for (unsigned int i = 0; i < IMAGE_COUNT; i++)
+    {
+      images.push_back(new ResidentImage(device, { IMAGE_SIZE, IMAGE_SIZE }, VK_FORMAT_R8G8B8A8_UNORM, IMAGE_MIP_LEVELS,
+        VK_IMAGE_USAGE_SAMPLED_BIT));
+      uploadMips(images.back(), i);
+    }
+    uint32_t heapIndex = images[0]->GetDeviceLocalHeap();
+
+    // Dropping the top mip of half the textures is more than enough
+    budget->Update();
+    VkDeviceSize usageBefore = budget->GetHeapBudget(heapIndex).usage;
+    VkDeviceSize limit = usageBefore - IMAGE_COUNT / 2 * images[0]->GetMipSize(0) / 2;
+    residency->SetHeapLimit(heapIndex, limit);
+
+    // The second half of the textures is sampled every frame, the first half never
+    for (unsigned int frame = 0; frame < FRAMES; frame++)
+    {
+      for (unsigned int i = IMAGE_COUNT / 2; i < IMAGE_COUNT; i++)
+      {
+        images[i]->Touch();
+      }
+      residency->NextFrame();
+    }
+    residency->SetHeapLimit(heapIndex, std::numeric_limits<VkDeviceSize>::max());
+
+    VkDeviceSize usageAfter = budget->GetHeapBudget(heapIndex).usage;
+    std::printf("  heap %u usage %.1f MB -> %.1f MB, limit %.1f MB\n", heapIndex,
+      usageBefore / 1048576.0, usageAfter / 1048576.0, limit / 1048576.0);
+    bool correct = check(usageAfter < usageBefore, "device local usage went down");
+
+    bool coldDemoted = true;
+    bool hotResident = true;
+    for (unsigned int i = 0; i < IMAGE_COUNT; i++)
+    {
+      if (i < IMAGE_COUNT / 2) {
+        coldDemoted = coldDemoted && images[i]->GetResidentMipLevel() > 0;
+      } else {
+        hotResident = hotResident && images[i]->GetResidentMipLevel() == 0;
+      }
+    }
+    correct = check(coldDemoted, "textures never sampled dropped their top mips") && correct;
+    correct = check(hotResident, "textures sampled every frame keep all mips") && correct;
+
+    bool contentsKept = true;
+    for (unsigned int i = 0; i < IMAGE_COUNT; i++)
+    {
+      for (uint32_t level = images[i]->GetResidentMipLevel(); level < IMAGE_MIP_LEVELS; level++)
+      {
+        std::vector<uint32_t> texels(images[i]->GetMipSize(level) / sizeof(uint32_t));
+        images[i]->Download(level, texels.data());
+        uint32_t expected = i << 8 | level;
+        contentsKept = contentsKept && std::all_of(texels.begin(), texels.end(), [expected](uint32_t value) { return value == expected; });
+      }
+    }
+    correct = check(contentsKept, "remaining mips keep their contents") && correct;
+
+    // Streaming the top mips back in restores the full chain, tagged as a new image to tell it apart
+    images[0]->Restore();
+    uploadMips(images[0], IMAGE_COUNT);
+    std::vector<uint32_t> texels(images[0]->GetMipSize(0) / sizeof(uint32_t));
+    images[0]->Download(0, texels.data());
+    correct = check(images[0]->GetResidentMipLevel() == 0 && texels.front() == IMAGE_COUNT << 8 && texels.back() == IMAGE_COUNT << 8,
+      "restored texture holds every mip again") && correct;
+
+    for (ResidentImage* image : images)
+    {
+      delete image;
+    }
+    return correct;
+  }
+
+  /**
+   * @brief Demotion needs host visible memory outside the device local heap
+   */
+  bool hasSeparateHostHeap(Device* device, uint32_t deviceLocalHeap) {
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = device->GetMemoryProperties();
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+      if ((memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        memoryProperties.memoryTypes[i].heapIndex != deviceLocalHeap) {
+        return true;
+      }
+    }
+    return false;
+  }
+} // namespace
+
+int main()
+{
+  // Headless, no surface or swap chain needed
+  Instance* instance = new Instance("Residency Benchmark", 0, nullptr);
+  instance->PickPhysicalDevice({}, QueueFlagBit::TransferBit, VK_NULL_HANDLE);
+  Device* device = instance->CreateDevice(QueueFlagBit::TransferBit, {});
+
+  std::printf("Residency on %s\n\n", device->GetProperties().deviceName);
+
+  std::vector<ResidentBuffer*> buffers;
+  std::vector<uint32_t> contents(BUFFER_SIZE / sizeof(uint32_t));
+  for (unsigned int i = 0; i < BUFFER_COUNT; i++)
+  {
+    buffers.push_back(new ResidentBuffer(device, BUFFER_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
+    std::fill(contents.begin(), contents.end(), i);
+    buffers.back()->Upload(contents.data(), BUFFER_SIZE);
+  }
+  uint32_t heapIndex = buffers[0]->GetDeviceLocalHeap();
+
+  std::printf("LRU order\n");
+  bool correct = checkLruOrder(device, heapIndex);
+
+  std::printf("\nDemotion to host memory\n");
+  if (hasSeparateHostHeap(device, heapIndex)) {
+    correct = checkDemotion(device, buffers) && correct;
+  } else {
+    std::printf("  skipped, host visible memory shares the device local heap\n");
+  }
+
+  for (ResidentBuffer* buffer : buffers)
+  {
+    delete buffer;
+  }
+
+  std::printf("\nDropping top mips of textures\n");
+  correct = checkMipDemotion(device) && correct;
+  delete device;
+  delete instance;
+  return correct ? 0 : 1;
+}
@@ -0,0 +1,421 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "ComputePrimitives.h"
+#include "Device.h"
+#include "Instance.h"
+#include "QueueFlags.h"
+#include "ShardScheduler.h"
+
+namespace
+{
+  const uint32_t BATCH_SIZE = 1 << 16;
+  const unsigned int ROUNDS = 6;
+  const uint32_t RENDER_SIZE = 512;
+
+  double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+  }
+
+  /**
+   * @brief Per device sort state, only touched by that device's worker
+   */
+  struct DeviceSorter
+  {
+    ComputePrimitives* primitives;
+    ComputeBuffer keys;
+    ComputeBuffer values;
+  };
+
+  /**
+   * @brief Sort every batch of keys on the GPU, each batch with its indices
+   *        as values, and check the results against the CPU sort
+   */
+  bool sortBatches(ShardScheduler& scheduler, std::vector<DeviceSorter>& sorters,
+    const std::vector<uint32_t>& keys, const std::vector<uint32_t>& expected, size_t batchCount) {
+    std::vector<uint32_t> sorted(keys.size());
+    std::vector<unsigned char> batchCorrect(batchCount, 0);
+
+    scheduler.Run(batchCount, [&](unsigned int deviceIndex, Device*, size_t begin, size_t end) {
+      DeviceSorter& sorter = sorters[deviceIndex];
+      std::vector<uint32_t> indices(BATCH_SIZE);
+      for (size_t batch = begin; batch < end; batch++)
+      {
+        const uint32_t* batchKeys = keys.data() + batch * BATCH_SIZE;
+        for (uint32_t i = 0; i < BATCH_SIZE; i++)
+        {
+          indices[i] = i;
+        }
+
+        sorter.primitives->Upload(sorter.keys, batchKeys, BATCH_SIZE * sizeof(uint32_t));
+        sorter.primitives->Upload(sorter.values, indices.data(), BATCH_SIZE * sizeof(uint32_t));
+        sorter.primitives->Execute([&](VkCommandBuffer commandBuffer) {
+          sorter.primitives->RecordRadixSort(commandBuffer, sorter.keys, sorter.values, BATCH_SIZE);
+        });
+        sorter.primitives->Download(sorter.keys, sorted.data() + batch * BATCH_SIZE, BATCH_SIZE * sizeof(uint32_t));
+        sorter.primitives->Download(sorter.values, indices.data(), BATCH_SIZE * sizeof(uint32_t));
+
+        // Keys must match the reference and the values must still point at them
+        bool correct = std::equal(expected.begin() + batch * BATCH_SIZE, expected.begin() + (batch + 1) * BATCH_SIZE,
+          sorted.begin() + batch * BATCH_SIZE);
+        for (uint32_t i = 0; correct && i < BATCH_SIZE; i++)
+        {
+          correct = indices[i] < BATCH_SIZE && batchKeys[indices[i]] == sorted[batch * BATCH_SIZE + i];
+        }
+        batchCorrect[batch] = correct;
+      }
+    });
+
+    return std::find(batchCorrect.begin(), batchCorrect.end(), 0) == batchCorrect.end();
+  }
+
+  /**
+   * @brief Per device offscreen target for the simulated render shard, only
+   *        touched by that device's worker
+   */
+  struct DeviceRenderer
+  {
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkImage image;
+    VkDeviceMemory imageMemory;
+    VkBuffer readback;
+    VkDeviceMemory readbackMemory;
+    const uint32_t* pixels;
+  };
+
+  DeviceRenderer createRenderer(Device* device) {
+    VkDevice vkDevice = device->GetVkDevice();
+    DeviceRenderer renderer = {};
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = device->GetQueueIndex(QueueFlags::Compute);
+    if (vkCreateCommandPool(vkDevice, &poolInfo, nullptr, &renderer.commandPool) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create command pool");
+    }
+
+    VkCommandBufferAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocateInfo.commandPool = renderer.commandPool;
+    allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocateInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(vkDevice, &allocateInfo, &renderer.commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to allocate command buffer");
+    }
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = { RENDER_SIZE, RENDER_SIZE, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(vkDevice, &imageInfo, nullptr, &renderer.image) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create offscreen image");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(vkDevice, renderer.image, &requirements);
+    renderer.imageMemory = device->AllocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    vkBindImageMemory(vkDevice, renderer.image, renderer.imageMemory, 0);
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = RENDER_SIZE * RENDER_SIZE * sizeof(uint32_t);
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(vkDevice, &bufferInfo, nullptr, &renderer.readback) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create readback buffer");
+    }
+
+    vkGetBufferMemoryRequirements(vkDevice, renderer.readback, &requirements);
+    renderer.readbackMemory = device->AllocateMemory(requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    vkBindBufferMemory(vkDevice, renderer.readback, renderer.readbackMemory, 0);
+
+    void* mapped;
+    if (vkMapMemory(vkDevice, renderer.readbackMemory, 0, bufferInfo.size, 0, &mapped) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to map readback buffer");
+    }
+    renderer.pixels = static_cast<const uint32_t*>(mapped);
+    return renderer;
+  }
+
+  void destroyRenderer(Device* device, DeviceRenderer& renderer) {
+    VkDevice vkDevice = device->GetVkDevice();
+    vkUnmapMemory(vkDevice, renderer.readbackMemory);
+    vkDestroyBuffer(vkDevice, renderer.readback, nullptr);
+    device->FreeMemory(renderer.readbackMemory);
+    vkDestroyImage(vkDevice, renderer.image, nullptr);
+    device->FreeMemory(renderer.imageMemory);
+    vkDestroyCommandPool(vkDevice, renderer.commandPool, nullptr);
+  }
+
+  void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+    VkImageLayout oldLayout, VkImageLayout newLayout) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, 0, nullptr, 0, nullptr, 1, &barrier);
+  }
+
+  /**
+   * @brief Packed R8G8B8A8 color every pixel of a frame is cleared to, unique
+   *        per frame so a readback of the wrong frame shows up
+   */
+  uint32_t frameColor(size_t frame) {
+    return static_cast<uint32_t>(frame & 0xffffff) | 0xff000000u;
+  }
+
+  /**
+   * @brief Stand-in for an offscreen render job: clear the offscreen image
+   *        to the frame's color and read it back, one submit per frame. There
+   *        is no render pass, pipeline or draw, the transfer commands run on
+   *        the compute queue every device here has.
+   */
+  bool renderFrame(Device* device, DeviceRenderer& renderer, size_t frame) {
+    VkCommandBuffer commandBuffer = renderer.commandBuffer;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    // The previous frame's contents are not needed, start from an undefined layout every time
+    imageBarrier(commandBuffer, renderer.image, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    uint32_t color = frameColor(frame);
+    VkClearColorValue clearColor;
+    for (unsigned int channel = 0; channel < 4; channel++)
+    {
+      clearColor.float32[channel] = ((color >> (8 * channel)) & 0xff) / 255.0f;
+    }
+    VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdClearColorImage(commandBuffer, renderer.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+
+    imageBarrier(commandBuffer, renderer.image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { RENDER_SIZE, RENDER_SIZE, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, renderer.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, renderer.readback, 1, &region);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to record offscreen frame");
+    }
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    SyncPool* syncPool = device->GetSyncPool();
+    VkFence fence = syncPool->AcquireFence();
+    if (vkQueueSubmit(device->GetQueue(QueueFlags::Compute), 1, &submitInfo, fence) != VK_SUCCESS) {
+      syncPool->ReleaseFence(fence);
+      throw std::runtime_error("Failed to submit offscreen frame");
+    }
+    if (vkWaitForFences(device->GetVkDevice(), 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+      // A fence whose wait failed may still be pending, do not hand it out again
+      throw std::runtime_error("Failed to wait for offscreen frame");
+    }
+    syncPool->ReleaseFence(fence);
+
+    const uint32_t* pixels = renderer.pixels;
+    return std::all_of(pixels, pixels + RENDER_SIZE * RENDER_SIZE, [color](uint32_t pixel) { return pixel == color; });
+  }
+
+  /**
+   * @brief Run the simulated render job for every frame and check each
+   *        readback holds its frame's clear color
+   */
+  bool renderFrames(ShardScheduler& scheduler, std::vector<DeviceRenderer>& renderers, size_t frameCount) {
+    std::vector<unsigned char> frameCorrect(frameCount, 0);
+
+    scheduler.Run(frameCount, [&](unsigned int deviceIndex, Device* device, size_t begin, size_t end) {
+      for (size_t frame = begin; frame < end; frame++)
+      {
+        frameCorrect[frame] = renderFrame(device, renderers[deviceIndex], frame);
+      }
+    });
+
+    return std::find(frameCorrect.begin(), frameCorrect.end(), 0) == frameCorrect.end();
+  }
+
+  void printStats(const std::vector<Device*>& devices, const std::vector<ShardDeviceStats>& stats) {
+    std::printf("  %-3s %-28s %7s %7s %7s %9s %9s %7s\n", "#", "device", "weight", "items", "stolen", "busy ms", "item/s", "util");
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+      std::printf("  %-3zu %-28.28s %7.3f %7zu %7zu %9.1f %9.1f %6.0f%%\n", i, devices[i]->GetProperties().deviceName,
+        stats[i].weight, stats[i].items, stats[i].stolenChunks, stats[i].busyMilliseconds,
+        stats[i].throughput * 1e3, stats[i].utilization * 100.0);
+    }
+  }
+} // namespace
+
+/**
+ * Usage: sharding_benchmark [batch count] [--devices-per-gpu N]
+ *
+ * Shards radix sorts, then simulated offscreen frames over the devices. A
+ * frame is only cleared and read back, no render pass or draw is recorded.
+ *
+ * Opens a device on every GPU with a compute queue. With --devices-per-gpu
+ * each GPU gets several logical devices, which exercises the sharding on a
+ * machine with a single GPU or a software driver such as lavapipe.
+ */
+int main(int argc, char const *argv[])
+{
+  size_t batchCount = 64;
+  unsigned int devicesPerGpu = 1;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--devices-per-gpu") == 0 && i + 1 < argc) {
+      devicesPerGpu = std::max(1, std::atoi(argv[++i]));
+    } else {
+      batchCount = std::max<size_t>(1, std::strtoull(argv[i], nullptr, 10));
+    }
+  }
+
+  // Headless, no surface or swap chain needed
+  Instance* instance = new Instance("Sharding Benchmark", 0, nullptr);
+  std::vector<Device*> devices = instance->CreateDevices({}, QueueFlagBit::ComputeBit, {}, devicesPerGpu);
+
+  std::vector<DeviceSorter> sorters(devices.size());
+  for (size_t i = 0; i < devices.size(); i++)
+  {
+    // Host visible so uploads and downloads need no staging
+    const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    sorters[i].primitives = new ComputePrimitives(devices[i]);
+    sorters[i].primitives->Reserve(BATCH_SIZE);
+    sorters[i].keys = sorters[i].primitives->CreateBuffer(BATCH_SIZE * sizeof(uint32_t), hostVisible);
+    sorters[i].values = sorters[i].primitives->CreateBuffer(BATCH_SIZE * sizeof(uint32_t), hostVisible);
+  }
+
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<uint32_t> keyDistribution;
+  std::vector<uint32_t> keys(batchCount * BATCH_SIZE);
+  for (uint32_t& key : keys)
+  {
+    key = keyDistribution(random);
+  }
+
+  std::vector<uint32_t> expected = keys;
+  for (size_t batch = 0; batch < batchCount; batch++)
+  {
+    std::sort(expected.begin() + batch * BATCH_SIZE, expected.begin() + (batch + 1) * BATCH_SIZE);
+  }
+
+  std::printf("Sharding %zu radix sorts of %u keys over %zu devices (%u per GPU)\n\n",
+    batchCount, BATCH_SIZE, devices.size(), devicesPerGpu);
+
+  bool allCorrect = true;
+
+  // --- Single device baseline ---
+  double singleTime;
+  {
+    ShardScheduler single({ devices[0] });
+    sortBatches(single, sorters, keys, expected, batchCount);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    allCorrect = sortBatches(single, sorters, keys, expected, batchCount) && allCorrect;
+    singleTime = millisecondsSince(start);
+  }
+  std::printf("1 device:   %9.1f ms  %9.1f batch/s\n", singleTime, batchCount / (singleTime / 1e3));
+
+  // --- All devices, a few rounds so the weights settle on the measured throughput ---
+  ShardScheduler scheduler(devices);
+  double shardedTime = 0.0;
+  for (unsigned int round = 0; round < ROUNDS; round++)
+  {
+    scheduler.ResetStats();
+    auto start = std::chrono::high_resolution_clock::now();
+    allCorrect = sortBatches(scheduler, sorters, keys, expected, batchCount) && allCorrect;
+    shardedTime = millisecondsSince(start);
+  }
+  std::printf("%zu devices: %9.1f ms  %9.1f batch/s  %.2fx\n\n", devices.size(), shardedTime,
+    batchCount / (shardedTime / 1e3), singleTime / shardedTime);
+
+  std::printf("Last round per device:\n");
+  printStats(devices, scheduler.GetStats());
+
+  if (!allCorrect) {
+    std::printf("\nSome batches did not match the CPU sort\n");
+  }
+
+  // --- Simulated offscreen render shard, one clear and readback per frame ---
+  std::vector<DeviceRenderer> renderers;
+  for (Device* device : devices)
+  {
+    renderers.push_back(createRenderer(device));
+  }
+
+  // A scheduler of its own, the sort's throughput estimates say nothing about frames
+  ShardScheduler renderScheduler(devices);
+  size_t frameCount = batchCount * 4;
+  bool framesCorrect = true;
+  double renderTime = 0.0;
+  for (unsigned int round = 0; round < ROUNDS; round++)
+  {
+    renderScheduler.ResetStats();
+    auto start = std::chrono::high_resolution_clock::now();
+    framesCorrect = renderFrames(renderScheduler, renderers, frameCount) && framesCorrect;
+    renderTime = millisecondsSince(start);
+  }
+  std::printf("\nSimulated rendering, clear and readback of %zu offscreen frames of %ux%u over %zu devices: %9.1f ms  %9.1f frame/s\n\n",
+    frameCount, RENDER_SIZE, RENDER_SIZE, devices.size(), renderTime, frameCount / (renderTime / 1e3));
+  std::printf("Last round per device:\n");
+  printStats(devices, renderScheduler.GetStats());
+
+  if (!framesCorrect) {
+    std::printf("\nSome frames did not read back their clear color\n");
+  }
+  allCorrect = allCorrect && framesCorrect;
+
+  for (size_t i = 0; i < devices.size(); i++)
+  {
+    destroyRenderer(devices[i], renderers[i]);
+  }
+
+  for (DeviceSorter& sorter : sorters)
+  {
+    sorter.primitives->DestroyBuffer(sorter.keys);
+    sorter.primitives->DestroyBuffer(sorter.values);
+    delete sorter.primitives;
+  }
+  for (Device* device : devices)
+  {
+    delete device;
+  }
+  delete instance;
+  return allCorrect ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+
+#include "SpirvReflection.h"
+
+namespace
+{
+  /**
+   * @brief Ways to break the otherwise valid test module
+   */
+  enum class Malformation
+  {
+    None,
+    UnterminatedEntryPointName,
+    ExecutionModeWithoutMode,
+    DecorationWithoutOperand,
+    MemberDecorationWithoutOperand,
+    SelfReferentialArray,
+    SelfReferentialStruct,
+  };
+
+  void addInstruction(std::vector<uint32_t>& module, uint32_t opcode, std::initializer_list<uint32_t> operands) {
+    module.push_back(static_cast<uint32_t>(operands.size() + 1) << 16 | opcode);
+    module.insert(module.end(), operands.begin(), operands.end());
+  }
+
+  /**
+   * @brief Compute shader with a LocalSize of 8 x 4 x 1 and a storage buffer
+   *        at set 0 binding 1, assembled by hand so no compiler is needed
+   */
+  std::vector<uint32_t> buildModule(Malformation malformation) {
+    std::vector<uint32_t> module = { 0x07230203, 0x00010300, 0, 33, 0 };
+
+    addInstruction(module, 17, { 1 });     // OpCapability Shader
+    addInstruction(module, 14, { 0, 1 });  // OpMemoryModel Logical GLSL450
+
+    // OpEntryPoint GLCompute %1 "main", the name without its terminator fills whole words
+    char name[8] = "main";
+    if (malformation == Malformation::UnterminatedEntryPointName) {
+      std::memcpy(name, "mainmain", sizeof(name));
+    }
+    uint32_t nameWords[2];
+    std::memcpy(nameWords, name, sizeof(name));
+    addInstruction(module, 15, { 5, 1, nameWords[0], nameWords[1] });
+
+    if (malformation == Malformation::ExecutionModeWithoutMode) {
+      addInstruction(module, 16, { 1 });
+    } else {
+      addInstruction(module, 16, { 1, 17, 8, 4, 1 });  // OpExecutionMode %1 LocalSize 8 4 1
+    }
+
+    addInstruction(module, 71, { 20, 2 });  // OpDecorate %20 Block
+    if (malformation == Malformation::MemberDecorationWithoutOperand) {
+      addInstruction(module, 72, { 20, 0, 35 });
+    } else {
+      addInstruction(module, 72, { 20, 0, 35, 0 });  // OpMemberDecorate %20 0 Offset 0
+    }
+    addInstruction(module, 71, { 22, 34, 0 });  // OpDecorate %22 DescriptorSet 0
+    if (malformation == Malformation::DecorationWithoutOperand) {
+      addInstruction(module, 71, { 22, 33 });
+    } else {
+      addInstruction(module, 71, { 22, 33, 1 });  // OpDecorate %22 Binding 1
+    }
+
+    addInstruction(module, 21, { 2, 32, 0 });    // %2 = OpTypeInt 32 0
+    if (malformation == Malformation::SelfReferentialArray) {
+      // %19 = OpTypeRuntimeArray %19, with the variable pointing straight at it
+      addInstruction(module, 29, { 19, 19 });
+      addInstruction(module, 30, { 20, 19 });
+      addInstruction(module, 32, { 21, 12, 19 });
+    } else {
+      addInstruction(module, 29, { 19, 2 });       // %19 = OpTypeRuntimeArray %2
+      addInstruction(module, 30, { 20, 19 });      // %20 = OpTypeStruct %19
+      addInstruction(module, 32, { 21, 12, 20 });  // %21 = OpTypePointer StorageBuffer %20
+    }
+    addInstruction(module, 59, { 21, 22, 12 });  // %22 = OpVariable %21 StorageBuffer
+
+    if (malformation == Malformation::SelfReferentialStruct) {
+      // Push constant block %30 = OpTypeStruct %2 %30
+      addInstruction(module, 30, { 30, 2, 30 });
+      addInstruction(module, 32, { 31, 9, 30 });
+      addInstruction(module, 59, { 31, 32, 9 });
+    }
+    return module;
+  }
+
+  bool check(bool condition, const char* what) {
+    std::printf("  %-62s %s\n", what, condition ? "ok" : "FAILED");
+    return condition;
+  }
+
+  bool rejects(const std::vector<uint32_t>& module, const char* what) {
+    bool rejected = false;
+    try {
+      ReflectSpirv(module.data(), module.size());
+    } catch (const std::runtime_error&) {
+      rejected = true;
+    }
+    return check(rejected, what);
+  }
+} // namespace
+
+/**
+ * Feeds SpirvReflection a valid module and truncated or malformed variants
+ * of it. Every malformed module has to be rejected with an exception rather
+ * than read past its instructions or recurse through types without end.
+ */
+int main()
+{
+  std::printf("Valid module\n");
+  std::vector<uint32_t> valid = buildModule(Malformation::None);
+  bool correct = true;
+  try {
+    ShaderReflection reflection = ReflectSpirv(valid.data(), valid.size());
+    correct = check(reflection.stage == VK_SHADER_STAGE_COMPUTE_BIT && reflection.entryPoint == "main",
+      "compute entry point main") && correct;
+    correct = check(reflection.localSize[0] == 8 && reflection.localSize[1] == 4 && reflection.localSize[2] == 1,
+      "local size 8 x 4 x 1") && correct;
+    correct = check(reflection.descriptorSets.size() == 1 && reflection.descriptorSets[0].size() == 1 &&
+      reflection.descriptorSets[0][0].binding == 1 &&
+      reflection.descriptorSets[0][0].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      "storage buffer at set 0 binding 1") && correct;
+  } catch (const std::runtime_error& error) {
+    std::printf("  rejected: %s\n", error.what());
+    correct = false;
+  }
+
+  std::printf("\nMalformed modules\n");
+  std::vector<uint32_t> truncated(valid.begin(), valid.end() - 1);
+  correct = rejects(truncated, "last instruction cut short") && correct;
+  correct = rejects(std::vector<uint32_t>(valid.begin(), valid.begin() + 3), "header cut short") && correct;
+  correct = rejects(buildModule(Malformation::UnterminatedEntryPointName), "entry point name without terminator") && correct;
+  correct = rejects(buildModule(Malformation::ExecutionModeWithoutMode), "OpExecutionMode without a mode") && correct;
+  correct = rejects(buildModule(Malformation::DecorationWithoutOperand), "OpDecorate Binding without its operand") && correct;
+  correct = rejects(buildModule(Malformation::MemberDecorationWithoutOperand), "OpMemberDecorate Offset without its operand") && correct;
+  correct = rejects(buildModule(Malformation::SelfReferentialArray), "runtime array of itself") && correct;
+  correct = rejects(buildModule(Malformation::SelfReferentialStruct), "push constant struct containing itself") && correct;
+
+  return correct ? 0 : 1;
+}
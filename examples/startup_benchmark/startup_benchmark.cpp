@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Startup.h"
+
+namespace
+{
+  const unsigned int WARM_ITERATIONS = 5;
+
+  void printHeader() {
+    std::printf("%-20s %8s %8s %8s %8s %8s %8s %8s %8s\n",
+      "ms", "glfw", "window", "instance", "pick", "device", "surface", "swapch", "total");
+  }
+
+  void printTimings(const char* name, const StartupTimings& timings) {
+    std::printf("%-20s %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n", name,
+      timings.glfwMilliseconds, timings.windowMilliseconds, timings.instanceMilliseconds,
+      timings.physicalDeviceMilliseconds, timings.deviceMilliseconds, timings.surfaceMilliseconds,
+      timings.swapChainMilliseconds, timings.totalMilliseconds);
+    std::fflush(stdout);
+  }
+
+  StartupTimings runOnce(bool parallel) {
+    StartupOptions options;
+    options.applicationName = "Startup Benchmark";
+    options.parallel = parallel;
+
+    StartupContext context = InitializeVulkan(options);
+    StartupTimings timings = context.timings;
+    DestroyVulkan(context);
+    return timings;
+  }
+
+  /**
+   * @brief Best of each phase separately, the phases are independent enough
+   *        that one slow outlier should not hide the others
+   */
+  StartupTimings bestOf(const std::vector<StartupTimings>& runs) {
+    StartupTimings best = runs.front();
+    for (const StartupTimings& run : runs)
+    {
+      best.glfwMilliseconds = std::min(best.glfwMilliseconds, run.glfwMilliseconds);
+      best.windowMilliseconds = std::min(best.windowMilliseconds, run.windowMilliseconds);
+      best.instanceMilliseconds = std::min(best.instanceMilliseconds, run.instanceMilliseconds);
+      best.physicalDeviceMilliseconds = std::min(best.physicalDeviceMilliseconds, run.physicalDeviceMilliseconds);
+      best.deviceMilliseconds = std::min(best.deviceMilliseconds, run.deviceMilliseconds);
+      best.surfaceMilliseconds = std::min(best.surfaceMilliseconds, run.surfaceMilliseconds);
+      best.swapChainMilliseconds = std::min(best.swapChainMilliseconds, run.swapChainMilliseconds);
+      best.totalMilliseconds = std::min(best.totalMilliseconds, run.totalMilliseconds);
+    }
+    return best;
+  }
+} // namespace
+
+/**
+ * Cold numbers come from a fresh child process per path, so the Vulkan
+ * loader, ICD and the enumeration caches all start empty. Warm numbers are
+ * repeated startups inside this process.
+ */
+int main(int argc, char const *argv[])
+{
+  // Child process mode: one startup, one row
+  if (argc > 2 && strcmp(argv[1], "--once") == 0) {
+    bool parallel = strcmp(argv[2], "parallel") == 0;
+    printTimings(parallel ? "cold parallel" : "cold sequential", runOnce(parallel));
+    return 0;
+  }
+
+  std::printf("Startup benchmark, cold is a fresh process, warm is best of %u in process\n\n", WARM_ITERATIONS);
+  printHeader();
+
+  for (const char* path : { "sequential", "parallel" })
+  {
+    std::string command = std::string("\"") + argv[0] + "\" --once " + path;
+    if (std::system(command.c_str()) != 0) {
+      std::printf("cold %s run failed\n", path);
+    }
+  }
+
+  for (bool parallel : { false, true })
+  {
+    std::vector<StartupTimings> runs;
+    for (unsigned int i = 0; i < WARM_ITERATIONS; i++)
+    {
+      runs.push_back(runOnce(parallel));
+    }
+    printTimings(parallel ? "warm parallel" : "warm sequential", bestOf(runs));
+  }
+
+  return 0;
+}
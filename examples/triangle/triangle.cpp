@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
 
+#include "FrameLoop.h"
+#include "Startup.h"
 #include "Window.h"
 #include "Instance.h"
 #include "QueueFlags.h"
@@ -9,42 +14,161 @@
 Device* device;
 SwapChain* swapChain;
 
-int main(int argc, char const *argv[])
+VkCommandPool commandPool;
+VkCommandBuffer commandBuffer;
+
+// Written by the update thread, one per TripleBuffer slot
+float clearColors[TripleBuffer::SNAPSHOT_COUNT][4];
+
+namespace
 {
-  int width = 800;
-  int height = 800;
-  const char* applicationName = "Demo";
-  InitializeWindow(width, height, applicationName);
-
-  uint32_t glfwExtensionCount = 0;
-  const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-  Instance* instance = new Instance(applicationName, glfwExtensionCount, glfwExtensions);
-
-  VkSurfaceKHR surface;
-  if (glfwCreateWindowSurface(instance->GetVkInstance(), GetGLFWWindow(), nullptr, &surface) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create window surface");
+  void imageBarrier(VkImage image, VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
   }
 
-  instance->PickPhysicalDevice(
-    { VK_KHR_SWAPCHAIN_EXTENSION_NAME },
-    QueueFlagBit::ComputeBit | QueueFlagBit::GraphicsBit | QueueFlagBit::PresentBit | QueueFlagBit::TransferBit,
-    surface
-  );
-
-  VkPhysicalDeviceFeatures deviceFeatures = {};
-  deviceFeatures.tessellationShader = VK_TRUE;
-  deviceFeatures.fillModeNonSolid = VK_TRUE;
-  deviceFeatures.samplerAnisotropy = VK_TRUE;
-  device = instance->CreateDevice(
-    QueueFlagBit::ComputeBit | QueueFlagBit::GraphicsBit | QueueFlagBit::PresentBit | QueueFlagBit::TransferBit,
-    deviceFeatures
-  );
-
-  swapChain = device->CreateSwapChain(surface, 5);
-
-  while (!ShouldQuit()) {
-    glfwPollEvents();
+  /**
+   * @brief Advance the clear color's hue by one fixed step
+   */
+  void update(double step, unsigned int slot) {
+    static double time = 0.0;
+    time += step;
+
+    for (unsigned int channel = 0; channel < 3; channel++)
+    {
+      clearColors[slot][channel] = static_cast<float>(0.5 + 0.5 * std::sin(time + channel * 2.094));
+    }
+    clearColors[slot][3] = 1.0f;
   }
 
+  /**
+   * @brief Acquire, clear to the snapshot's color and present. Clearing needs
+   *        transfer destination usage, without it the image is only
+   *        transitioned for present.
+   */
+  void render(unsigned int slot) {
+    std::vector<SwapChain*> acquired = device->AcquireSwapChains({ swapChain });
+    if (acquired.empty()) {
+      // Minimized
+      return;
+    }
+
+    VkImage image = swapChain->GetVkImage(swapChain->GetIndex());
+    bool canClear = (swapChain->GetVkImageUsage() & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    if (canClear) {
+      imageBarrier(image, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+      VkClearColorValue clearColor;
+      std::copy(clearColors[slot], clearColors[slot] + 4, clearColor.float32);
+      VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+      vkCmdClearColorImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+
+      imageBarrier(image, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    } else {
+      imageBarrier(image, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to record frame");
+    }
+
+    // The layout transition waits for the presentation engine to release the image
+    VkSemaphore waitSemaphore = swapChain->GetImageAvailableVkSemaphore();
+    VkSemaphore signalSemaphore = swapChain->GetRenderFinishedVkSemaphore();
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &waitSemaphore;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signalSemaphore;
+
+    // One frame in flight, the command buffer is reused right away
+    SyncPool* syncPool = device->GetSyncPool();
+    VkFence fence = syncPool->AcquireFence();
+    VkResult result = vkQueueSubmit(device->GetQueue(QueueFlags::Graphics), 1, &submitInfo, fence);
+    if (result == VK_SUCCESS) {
+      result = vkWaitForFences(device->GetVkDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
+    }
+    if (result != VK_SUCCESS) {
+      // A fence whose wait failed may still be pending, do not hand it out again
+      throw std::runtime_error("Failed to submit frame");
+    }
+    syncPool->ReleaseFence(fence);
+
+    device->PresentSwapChains(acquired);
+  }
+} // namespace
+
+int main()
+{
+  StartupOptions options;
+  options.applicationName = "Demo";
+  options.width = 800;
+  options.height = 800;
+  options.deviceFeatures.tessellationShader = VK_TRUE;
+  options.deviceFeatures.fillModeNonSolid = VK_TRUE;
+  options.deviceFeatures.samplerAnisotropy = VK_TRUE;
+  options.swapChainBuffers = 5;
+
+  StartupContext context = InitializeVulkan(options);
+  device = context.device;
+  swapChain = context.swapChain;
+  std::cout << "Startup: " << context.timings.totalMilliseconds << " ms" << std::endl;
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = device->GetQueueIndex(QueueFlags::Graphics);
+  if (vkCreateCommandPool(device->GetVkDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create command pool");
+  }
+
+  VkCommandBufferAllocateInfo allocateInfo = {};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocateInfo.commandPool = commandPool;
+  allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocateInfo.commandBufferCount = 1;
+  if (vkAllocateCommandBuffers(device->GetVkDevice(), &allocateInfo, &commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate command buffer");
+  }
+
+  FrameLoop frameLoop;
+  frameLoop.SetUpdate(update);
+  frameLoop.SetRender(render);
+  frameLoop.Run();
+
+  FrameTimings timings = frameLoop.GetTimings();
+  std::cout << "Update: " << timings.update.averageMilliseconds << " ms avg, "
+            << "render: " << timings.render.averageMilliseconds << " ms avg, "
+            << "frame interval: " << timings.frameInterval.averageMilliseconds << " ms avg" << std::endl;
+
+  vkDeviceWaitIdle(device->GetVkDevice());
+  vkDestroyCommandPool(device->GetVkDevice(), commandPool, nullptr);
+  DestroyVulkan(context);
+
   return 0;
 }
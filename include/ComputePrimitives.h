@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class Device;
+class ShaderModule;
+
+struct ComputeBuffer
+{
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize size = 0;
+  // Persistently mapped pointer if the buffer is host visible
+  void* mapped = nullptr;
+};
+
+/**
+ * @brief Device-wide data-parallel building blocks on the Compute queue:
+ *        reduction, exclusive prefix sum, stream compaction and key/value
+ *        radix sort, all on 32-bit unsigned integers. Kernels use subgroup
+ *        arithmetic when the device supports it and fall back to shared
+ *        memory otherwise.
+ *
+ *        Record* functions must be called from inside Execute, which owns the
+ *        command buffer and the descriptor sets they allocate. Call Reserve
+ *        with the largest element count first, it sizes the scratch buffers
+ *        and tunes the tile sizes.
+ */
+class ComputePrimitives
+{
+public:
+  explicit ComputePrimitives(Device* device);
+  ~ComputePrimitives();
+
+  ComputeBuffer CreateBuffer(VkDeviceSize size, VkMemoryPropertyFlags properties);
+  void DestroyBuffer(ComputeBuffer& buffer);
+  void Upload(const ComputeBuffer& buffer, const void* data, VkDeviceSize size);
+  void Download(const ComputeBuffer& buffer, void* data, VkDeviceSize size);
+
+  void Reserve(uint32_t maxCount);
+
+  /**
+   * @brief Record work into a command buffer, submit it to the Compute queue
+   *        and wait for it to finish
+   */
+  void Execute(const std::function<void(VkCommandBuffer)>& record);
+
+  /**
+   * @brief Sum of count values written to the first element of result
+   */
+  void RecordReduce(VkCommandBuffer commandBuffer, const ComputeBuffer& input, const ComputeBuffer& result, uint32_t count);
+
+  /**
+   * @brief Exclusive prefix sum, input and output may be the same buffer
+   */
+  void RecordExclusiveScan(VkCommandBuffer commandBuffer, const ComputeBuffer& input, const ComputeBuffer& output, uint32_t count);
+
+  /**
+   * @brief Copy values with a non-zero flag to the front of output, keeping
+   *        their order, and write how many there were to resultCount
+   */
+  void RecordCompact(VkCommandBuffer commandBuffer, const ComputeBuffer& values, const ComputeBuffer& flags,
+    const ComputeBuffer& output, const ComputeBuffer& resultCount, uint32_t count);
+
+  /**
+   * @brief Stable sort of keys with their values, in place. Only the low
+   *        keyBits bits of the keys are looked at.
+   */
+  void RecordRadixSort(VkCommandBuffer commandBuffer, const ComputeBuffer& keys, const ComputeBuffer& values, uint32_t count, uint32_t keyBits = 32);
+
+  bool UsesSubgroups() const { return useSubgroups; }
+  uint32_t GetTileSize() const { return generalTuning.workgroupSize * generalTuning.itemsPerThread; }
+  uint32_t GetRadixTileSize() const { return radixTuning.workgroupSize * radixTuning.itemsPerThread; }
+
+private:
+  enum Kernel {
+    Reduce,
+    Scan,
+    Compact,
+    RadixCount,
+    RadixScatter,
+    KernelCount,
+  };
+
+  struct KernelParameters
+  {
+    uint32_t count;
+    uint32_t countNonZero;
+    uint32_t shift;
+    uint32_t tileCount;
+    uint32_t useOffsets;
+  };
+
+  struct Tuning
+  {
+    uint32_t workgroupSize;
+    uint32_t itemsPerThread;
+  };
+
+  struct BufferRange
+  {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize range;
+  };
+
+  void selectPipelines();
+  void dispatch(VkCommandBuffer commandBuffer, Kernel kernel, const std::vector<BufferRange>& buffers,
+    const KernelParameters& parameters, uint32_t groupCount);
+  void recordScan(VkCommandBuffer commandBuffer, BufferRange input, BufferRange output, uint32_t count, VkDeviceSize partialsOffset);
+  BufferRange partialsRange(VkDeviceSize elementOffset, uint32_t count) const;
+  VkDescriptorSet allocateDescriptorSet(Kernel kernel);
+
+  Device* device;
+  VkPhysicalDeviceLimits limits;
+  bool useSubgroups;
+  uint32_t subgroupSize;
+
+  Tuning generalTuning;
+  Tuning radixTuning;
+
+  // Modules and pipelines belong to the device's ShaderManager
+  std::array<const ShaderModule*, KernelCount> modules;
+  std::array<VkPipeline, KernelCount> pipelines;
+
+  std::vector<VkDescriptorPool> descriptorPools;
+  size_t currentDescriptorPool;
+
+  VkCommandPool commandPool;
+  VkCommandBuffer commandBuffer;
+
+  uint32_t reservedCount;
+  ComputeBuffer partials;
+  ComputeBuffer tileCounts;
+  ComputeBuffer scratchKeys;
+  ComputeBuffer scratchValues;
+};
+
+/**
+ * CPU reference implementations of the ComputePrimitives kernels
+ */
+namespace ComputeReference
+{
+  uint32_t Reduce(const std::vector<uint32_t>& values);
+  std::vector<uint32_t> ExclusiveScan(const std::vector<uint32_t>& values);
+  std::vector<uint32_t> Compact(const std::vector<uint32_t>& values, const std::vector<uint32_t>& flags);
+  void RadixSort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, uint32_t keyBits = 32);
+} // namespace ComputeReference
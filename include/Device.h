@@ -1,35 +1,136 @@
 #pragma once
 
 #include <array>
+#include <functional>
+#include <vector>
 #include <vulkan/vulkan.h>
 #include "QueueFlags.h"
 #include "SwapChain.h"
+#include "MemoryBudget.h"
+#include "ResidencyManager.h"
+#include "SyncPool.h"
+#include "ShaderManager.h"
 
+struct GLFWwindow;
+struct SurfaceSupport;
 class SwapChain;
 class Instance;
+
+/**
+ * @brief A physical device found suitable by Instance, with the queue
+ *        families and extensions a Device on it uses
+ */
+struct PhysicalDeviceInfo
+{
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  QueueFamilyIndices queueFamilyIndices;
+  VkPhysicalDeviceProperties properties;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  // Requested extensions plus the optional ones the device supports
+  std::vector<const char*> extensions;
+};
+
 class Device
 {
   friend class Instance;
 
 public:
-  SwapChain* CreateSwapChain(VkSurfaceKHR surface, unsigned int numBuffers);
+  /**
+   * @brief Create a swap chain for a surface. Any number of swap chains, one
+   *        per window, can share the device.
+   * 
+   * @param surface 
+   * @param numBuffers 
+   * @param window Window the surface belongs to, the one from InitializeWindow if null
+   * @return SwapChain* 
+   */
+  SwapChain* CreateSwapChain(VkSurfaceKHR surface, unsigned int numBuffers, GLFWwindow* window = nullptr);
+
+  /**
+   * @brief Acquire the next image of each swap chain
+   *
+   * @return std::vector<SwapChain*> The swap chains that acquired an image,
+   *         minimized windows are left out. Render and present only these.
+   */
+  std::vector<SwapChain*> AcquireSwapChains(const std::vector<SwapChain*>& swapChains);
+
+  /**
+   * @brief Present the acquired image of every swap chain with a single
+   *        vkQueuePresentKHR, waiting on each render finished semaphore.
+   *        Swap chains that turned out of date or suboptimal are recreated.
+   * 
+   * @param swapChains 
+   * @return true Every swap chain presented without being recreated
+   */
+  bool PresentSwapChains(const std::vector<SwapChain*>& swapChains);
 
   Instance* GetInstance();
   VkDevice GetVkDevice();
   VkQueue GetQueue(QueueFlags flag);
   unsigned int GetQueueIndex(QueueFlags flag);
 
+  VkPhysicalDevice GetPhysicalDevice() const { return physicalDevice.physicalDevice; }
+  const QueueFamilyIndices& GetQueueFamilyIndices() const { return physicalDevice.queueFamilyIndices; }
+  const VkPhysicalDeviceProperties& GetProperties() const { return physicalDevice.properties; }
+  const VkPhysicalDeviceMemoryProperties& GetMemoryProperties() const { return physicalDevice.memoryProperties; }
+  bool IsExtensionEnabled(const char* extension) const;
+
+  SurfaceSupport QuerySurfaceSupport(VkSurfaceKHR surface) const;
+
+  /**
+   * @brief Check the present queue family can present to the surface.
+   *        Picking the physical device only checked the surface it was given.
+   */
+  bool SupportsPresent(VkSurfaceKHR surface) const;
+
+  /**
+   * @brief Find a memory type allowed by typeBits that has all the requested properties
+   * 
+   * @return uint32_t Memory type index, throws if there is none
+   */
+  uint32_t FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties);
+
+  /**
+   * @brief Allocate device memory and account it in the memory budget
+   */
+  VkDeviceMemory AllocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties);
+  VkDeviceMemory AllocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex);
+  void FreeMemory(VkDeviceMemory memory);
+
+  /**
+   * @brief Record commands into a one time command buffer, submit it to the
+   *        queue and wait for it to finish. For setup and copies outside the
+   *        frame, it creates and destroys a command pool every call.
+   */
+  void ExecuteOnce(QueueFlags queue, const std::function<void(VkCommandBuffer)>& record);
+
+  MemoryBudget* GetMemoryBudget();
+
+  /**
+   * @brief Residency of the device's ResidentBuffers and ResidentImages.
+   *        Call NextFrame on it once per frame to keep device local memory
+   *        within budget.
+   */
+  ResidencyManager* GetResidencyManager();
+  SyncPool* GetSyncPool();
+  ShaderManager* GetShaderManager();
+
   ~Device();
 
 private:
   using Queues = std::array<VkQueue, sizeof(QueueFlags)>;
 
   Device() = delete;
-  Device(Instance* instance, VkDevice vkDevice, Queues queues);
+  Device(Instance* instance, const PhysicalDeviceInfo& physicalDevice, VkDevice vkDevice, Queues queues);
 
   Instance* instance;
+  PhysicalDeviceInfo physicalDevice;
   VkDevice vkDevice;
   Queues queues;
+  MemoryBudget* memoryBudget;
+  ResidencyManager* residencyManager;
+  SyncPool* syncPool;
+  ShaderManager* shaderManager;
 };
 
 
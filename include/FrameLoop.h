@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Lock-free triple buffer of slot indices. The producer always owns one
+ *        slot, the consumer another, and the third holds the latest published
+ *        snapshot, so neither side ever waits on the other. The caller keeps
+ *        the actual data in an array of SNAPSHOT_COUNT elements.
+ */
+class TripleBuffer
+{
+public:
+  static constexpr unsigned int SNAPSHOT_COUNT = 3;
+
+  TripleBuffer();
+
+  unsigned int GetWriteIndex() const { return writeIndex; }
+  unsigned int GetReadIndex() const { return readIndex; }
+
+  /**
+   * @brief Producer side: hand the write slot over as the latest snapshot
+   */
+  void Publish();
+
+  /**
+   * @brief Consumer side: take the latest snapshot if one was published since
+   *        the previous call
+   *
+   * @return true The read slot now holds a new snapshot
+   */
+  bool Acquire();
+
+private:
+  static constexpr unsigned int FRESH_BIT = 1 << 2;
+  static constexpr unsigned int INDEX_MASK = FRESH_BIT - 1;
+
+  std::atomic<unsigned int> middle;
+  unsigned int writeIndex;
+  unsigned int readIndex;
+};
+
+struct FrameStageTiming
+{
+  double lastMilliseconds = 0.0;
+  double averageMilliseconds = 0.0;
+  double maxMilliseconds = 0.0;
+  uint64_t sampleCount = 0;
+};
+
+struct FrameTimings
+{
+  FrameStageTiming update;
+  FrameStageTiming render;
+  FrameStageTiming frameInterval;
+  uint64_t droppedUpdates = 0;
+};
+
+/**
+ * @brief Application loop on top of Window.h. Simulation runs at a fixed
+ *        timestep on an update thread and publishes snapshots through a
+ *        TripleBuffer, a render thread records whatever snapshot is newest, so
+ *        simulating frame N+1 overlaps with recording frame N. The calling
+ *        thread only pumps window events, sleeping in glfwWaitEvents while the
+ *        window is minimized or the loop is idle.
+ */
+class FrameLoop
+{
+public:
+  /**
+   * Advance the simulation by a fixed step and write its snapshot into the
+   * given slot of the caller's snapshot array
+   */
+  using UpdateFunction = std::function<void(double step, unsigned int slot)>;
+
+  /**
+   * Record and submit a frame from the given snapshot slot
+   */
+  using RenderFunction = std::function<void(unsigned int slot)>;
+
+  explicit FrameLoop(double updateRate = 60.0);
+
+  /**
+   * @brief Stops and joins the update and render threads if Run did not
+   */
+  ~FrameLoop();
+
+  void SetUpdate(UpdateFunction update) { this->update = update; }
+  void SetRender(RenderFunction render) { this->render = render; }
+
+  /**
+   * @brief Pause update and render threads and block on window events even
+   *        while the window is visible, e.g. when nothing on screen changes
+   *
+   * @param idle
+   */
+  void SetIdle(bool idle);
+
+  /**
+   * @brief Run until the window is asked to close. Must be called from the
+   *        thread that created the window.
+   */
+  void Run();
+
+  FrameTimings GetTimings() const;
+
+private:
+  void stop();
+  void updateLoop();
+  void renderLoop();
+  bool waitWhilePaused(std::unique_lock<std::mutex>& lock);
+  void recordTiming(FrameStageTiming& timing, double milliseconds);
+
+  UpdateFunction update;
+  RenderFunction render;
+  double step;
+
+  TripleBuffer snapshots;
+
+  std::atomic<bool> running;
+  std::atomic<bool> idle;
+  bool paused;
+  bool snapshotPublished;
+  std::mutex stateMutex;
+  std::condition_variable stateChanged;
+
+  std::thread updateThread;
+  std::thread renderThread;
+
+  mutable std::mutex timingMutex;
+  FrameTimings timings;
+};
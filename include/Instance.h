@@ -8,6 +8,23 @@
 
 extern const bool ENABLE_VALIDATION_LAYER;
 
+/**
+ * @brief What a surface supports on the picked physical device. Each window
+ *        has its own, query it whenever a swap chain for the surface is
+ *        (re)created since the capabilities follow the window size.
+ */
+struct SurfaceSupport
+{
+  VkSurfaceCapabilitiesKHR capabilities;
+  std::vector<VkSurfaceFormatKHR> formats;
+  std::vector<VkPresentModeKHR> presentModes;
+};
+
+/**
+ * @brief Formats, present modes and capabilities of a surface on a physical device
+ */
+SurfaceSupport QuerySurfaceSupport(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
+
 class Instance
 {
 private:
@@ -15,16 +32,15 @@ private:
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
 
-  QueueFamilyIndices queueFamilyIndices;
-  VkSurfaceCapabilitiesKHR surfaceCapabilities;
-  std::vector<VkSurfaceFormatKHR> surfaceFormats;
-  std::vector<VkPresentModeKHR> presentModes;
-  VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
-
-  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-  std::vector<const char*> deviceExtensions;
+  PhysicalDeviceInfo pickedDevice;
 
   void setupDebugMessenger();
+  std::vector<VkPhysicalDevice> enumeratePhysicalDevices() const;
+  bool checkPhysicalDevice(VkPhysicalDevice device, const std::vector<const char*>& deviceExtensions,
+    QueueFlagBits requiredQueues, VkSurfaceKHR surface, PhysicalDeviceInfo& info) const;
+  // Memory properties and optional extensions, only queried for devices a logical device is created on
+  void completePhysicalDeviceInfo(PhysicalDeviceInfo& info) const;
+  Device* createDevice(PhysicalDeviceInfo info, QueueFlagBits requiredQueues, VkPhysicalDeviceFeatures deviceFeatures);
 public:
   Instance() = delete;
   Instance(const char* applicationName, unsigned int additionalExtensionCount, const char** additionalExtensions);
@@ -32,14 +48,26 @@ public:
 
   VkInstance GetVkInstance() { return instance; }
 
+  /**
+   * @brief Pick the first physical device with the queues and extensions.
+   *        The surface may be VK_NULL_HANDLE even when Present is required,
+   *        present support is then asked from GLFW so the device can be
+   *        picked before the window exists.
+   */
   void PickPhysicalDevice(std::vector<const char*> deviceExtensions, QueueFlagBits requiredQueues, VkSurfaceKHR surface);
 
+  /**
+   * @brief Create a logical device on the device picked by PickPhysicalDevice
+   */
   Device* CreateDevice(QueueFlagBits requiredQueues, VkPhysicalDeviceFeatures deviceFeatures);
 
-  const QueueFamilyIndices& GetQueueFamilyIndices() const { return queueFamilyIndices; }
-  const VkSurfaceCapabilitiesKHR& GetSurfaceCapabilities() const { return surfaceCapabilities; }
-  const std::vector<VkSurfaceFormatKHR>& GetSurfaceFormats() const { return surfaceFormats; }
-  const std::vector<VkPresentModeKHR>& GetPresentModes() const { return presentModes; }
+  /**
+   * @brief Create a logical device on every suitable physical device, for
+   *        headless work spread over several GPUs. With devicesPerPhysicalDevice
+   *        above one each GPU gets several independent devices, which lets
+   *        multi-device code run on a machine with a single (software) GPU.
+   *        Throws if no physical device is suitable.
+   */
+  std::vector<Device*> CreateDevices(std::vector<const char*> deviceExtensions, QueueFlagBits requiredQueues,
+    VkPhysicalDeviceFeatures deviceFeatures, unsigned int devicesPerPhysicalDevice = 1);
 };
-
-
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class Device;
+
+struct HeapBudget
+{
+  VkDeviceSize size;
+  // Memory this process can use from the heap before risking eviction by the OS or driver
+  VkDeviceSize budget;
+  // Memory this process currently uses from the heap
+  VkDeviceSize usage;
+  // Memory allocated through Device::AllocateMemory, our own accounting
+  VkDeviceSize allocated;
+  bool deviceLocal;
+};
+
+/**
+ * @brief Per-heap memory budget and usage. Uses VK_EXT_memory_budget when the
+ *        device has it enabled, otherwise falls back to counting allocations
+ *        made through Device::AllocateMemory against a fixed share of each
+ *        heap's size.
+ */
+class MemoryBudget
+{
+public:
+  explicit MemoryBudget(Device* device);
+
+  /**
+   * @brief Re-query budget and usage from the driver. Cheap but not free,
+   *        once per frame is plenty; between updates usage is extrapolated
+   *        from our own allocations.
+   */
+  void Update();
+
+  bool IsDriverReported() const { return driverReported; }
+
+  std::vector<HeapBudget> GetHeapBudgets() const;
+  HeapBudget GetHeapBudget(uint32_t heapIndex) const;
+  uint32_t GetHeapIndex(uint32_t memoryTypeIndex) const;
+
+  void TrackAllocation(VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize size);
+  void TrackFree(VkDeviceMemory memory);
+
+private:
+  struct Allocation
+  {
+    uint32_t heapIndex;
+    VkDeviceSize size;
+  };
+
+  Device* device;
+  bool driverReported;
+
+  mutable std::mutex mutex;
+  std::vector<HeapBudget> heaps;
+  std::unordered_map<VkDeviceMemory, Allocation> allocations;
+};
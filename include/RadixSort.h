@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Sort 64-bit keys (and their 32-bit payloads) in ascending order with a
+ *        stable LSD radix sort using 8-bit digits. Digits on which every key
+ *        agrees are skipped. Inputs above a small threshold are split across
+ *        threadCount worker threads (0 picks std::thread::hardware_concurrency).
+ *
+ * @param keys
+ * @param values Must be the same length as keys
+ * @param threadCount
+ */
+void RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, unsigned int threadCount = 0);
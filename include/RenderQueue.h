@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/**
+ * @brief One draw as submitted by the scene. The ids come from the
+ *        Register* functions of the RenderQueue it is submitted to.
+ *        instanceIndex is the caller's per-object data index and ends up in
+ *        the instance index stream so merged draws can still find it.
+ */
+struct DrawItem
+{
+  uint32_t pipeline;
+  uint32_t descriptorSet;
+  uint32_t material;
+  uint32_t mesh;
+  float depth;
+  uint32_t instanceIndex;
+};
+
+/**
+ * @brief Consecutive sorted draws sharing pipeline, descriptor set, material
+ *        and mesh, issued as a single instanced draw.
+ */
+struct DrawBatch
+{
+  uint32_t pipeline;
+  uint32_t descriptorSet;
+  uint32_t material;
+  uint32_t mesh;
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+};
+
+struct RenderQueueStats
+{
+  size_t draws = 0;
+  size_t drawCalls = 0;
+  size_t pipelineBinds = 0;
+  size_t descriptorSetBinds = 0;
+  size_t meshBinds = 0;
+
+  size_t StateChanges() const { return pipelineBinds + descriptorSetBinds + meshBinds; }
+};
+
+class RenderQueue
+{
+public:
+  /**
+   * 64-bit sort key, most significant field first:
+   *   [63..52] pipeline  [51..40] descriptor set  [39..28] material
+   *   [27..16] mesh      [15..0]  depth (front to back)
+   * State fields sort before depth so equal state ends up contiguous.
+   */
+  static constexpr unsigned int PIPELINE_BITS = 12;
+  static constexpr unsigned int DESCRIPTOR_SET_BITS = 12;
+  static constexpr unsigned int MATERIAL_BITS = 12;
+  static constexpr unsigned int MESH_BITS = 12;
+  static constexpr unsigned int DEPTH_BITS = 16;
+
+  static uint64_t MakeSortKey(uint32_t pipeline, uint32_t descriptorSet, uint32_t material, uint32_t mesh, float depth);
+
+  explicit RenderQueue(unsigned int sortThreadCount = 0);
+
+  uint32_t RegisterPipeline(VkPipeline pipeline, VkPipelineLayout layout);
+  uint32_t RegisterDescriptorSet(VkDescriptorSet descriptorSet);
+  uint32_t RegisterMaterial(VkDescriptorSet materialSet);
+  uint32_t RegisterMesh(VkBuffer vertexBuffer, VkBuffer indexBuffer, uint32_t indexCount, VkIndexType indexType = VK_INDEX_TYPE_UINT32);
+
+  /**
+   * @brief Queue a draw. Throws if one of its ids was not registered.
+   */
+  void Submit(const DrawItem& item);
+  void Clear();
+
+  /**
+   * @brief Sort the submitted draws by key and merge runs of equal state into
+   *        instanced batches.
+   */
+  void Sort();
+
+  /**
+   * @brief Record the sorted batches, only binding state that changed since
+   *        the previous batch. The descriptor set binds at set 0 and the
+   *        material at set 1 of the pipeline layout, the mesh vertex buffer at
+   *        binding 0.
+   *
+   * @param commandBuffer
+   */
+  void Record(VkCommandBuffer commandBuffer) const;
+
+  const std::vector<DrawBatch>& GetBatches() const { return batches; }
+
+  /**
+   * @brief Per-instance DrawItem::instanceIndex values in sorted order, a
+   *        batch's instances start at DrawBatch::firstInstance. Upload as an
+   *        instance-rate vertex buffer or index a storage buffer with
+   *        gl_InstanceIndex.
+   */
+  const std::vector<uint32_t>& GetInstanceIndices() const { return instanceIndices; }
+
+  /**
+   * @brief Bind and draw counts of the sorted batches
+   */
+  RenderQueueStats GetStats() const;
+
+  /**
+   * @brief Bind and draw counts if the draws were recorded one by one in
+   *        submission order, the baseline the sorted stats compare against
+   */
+  RenderQueueStats GetUnsortedStats() const;
+
+private:
+  struct PipelineEntry
+  {
+    VkPipeline pipeline;
+    VkPipelineLayout layout;
+  };
+
+  struct MeshEntry
+  {
+    VkBuffer vertexBuffer;
+    VkBuffer indexBuffer;
+    uint32_t indexCount;
+    VkIndexType indexType;
+  };
+
+  unsigned int sortThreadCount;
+
+  std::vector<PipelineEntry> pipelines;
+  std::vector<VkDescriptorSet> descriptorSets;
+  std::vector<VkDescriptorSet> materials;
+  std::vector<MeshEntry> meshes;
+
+  std::vector<DrawItem> items;
+  std::vector<uint64_t> sortKeys;
+  std::vector<uint32_t> sortedItems;
+
+  std::vector<DrawBatch> batches;
+  std::vector<uint32_t> instanceIndices;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "MemoryBudget.h"
+
+struct ResidencyStats
+{
+  uint64_t evictions = 0;
+  VkDeviceSize evictedBytes = 0;
+  size_t residentResources = 0;
+  size_t nonResidentResources = 0;
+};
+
+/**
+ * @brief Keeps device memory usage under budget by demoting the least recently
+ *        used textures and buffers. The manager only decides what to demote,
+ *        how is up to each resource's evict function: drop its top mips,
+ *        move it to host visible memory, or free it outright. ResidentBuffer
+ *        implements the move to host memory, ResidentImage dropping top
+ *        mips. Resources used within the last
+ *        framesInFlight frames are never picked.
+ */
+class ResidencyManager
+{
+public:
+  using ResourceId = uint64_t;
+
+  /**
+   * Demote the resource one step and free the device memory it no longer
+   * needs through Device::FreeMemory. Gets the bytes currently resident on
+   * the heap, returns the bytes still resident afterwards. Returning the
+   * same size means the resource cannot be demoted any further. Called with
+   * the manager locked, so it must not call back into the manager.
+   */
+  using EvictFunction = std::function<VkDeviceSize(VkDeviceSize residentSize)>;
+
+  /**
+   * @param budget
+   * @param highWaterMark Start evicting from a heap above this share of its budget
+   * @param lowWaterMark Evict until the heap is back below this share
+   * @param framesInFlight
+   */
+  ResidencyManager(MemoryBudget* budget, float highWaterMark = 0.95f, float lowWaterMark = 0.85f, unsigned int framesInFlight = 2);
+
+  ResourceId Register(uint32_t heapIndex, VkDeviceSize residentSize, EvictFunction evict);
+  void Unregister(ResourceId id);
+
+  /**
+   * @brief Mark the resource as used by the current frame
+   */
+  void Touch(ResourceId id);
+
+  /**
+   * @brief Update the resident size after the resource was promoted again,
+   *        e.g. once its mips were streamed back in. A resource becoming
+   *        resident again counts as used by the current frame.
+   */
+  void SetResidentSize(ResourceId id, VkDeviceSize residentSize);
+
+  /**
+   * @brief Cap the budget of a heap below what the driver grants, e.g. to
+   *        leave room for other applications
+   */
+  void SetHeapLimit(uint32_t heapIndex, VkDeviceSize limit);
+
+  /**
+   * @brief Advance the frame counter, refresh the budget and enforce it
+   */
+  void NextFrame();
+
+  /**
+   * @brief Evict from every heap over its high water mark
+   *
+   * @return VkDeviceSize Bytes demoted
+   */
+  VkDeviceSize Enforce();
+
+  ResidencyStats GetStats() const;
+
+private:
+  struct Resource
+  {
+    uint32_t heapIndex;
+    VkDeviceSize residentSize;
+    uint64_t lastUsedFrame;
+    EvictFunction evict;
+    // Position in the heap's LRU list, front is least recently used
+    std::list<ResourceId>::iterator lruPosition;
+  };
+
+  VkDeviceSize evictFromHeap(uint32_t heapIndex, VkDeviceSize target);
+
+  MemoryBudget* budget;
+  float highWaterMark;
+  float lowWaterMark;
+  unsigned int framesInFlight;
+
+  mutable std::mutex mutex;
+  uint64_t frame;
+  ResourceId nextId;
+  std::unordered_map<ResourceId, Resource> resources;
+  std::vector<std::list<ResourceId>> lruLists;
+  std::vector<VkDeviceSize> heapLimits;
+  ResidencyStats stats;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "ResidencyManager.h"
+
+class Device;
+
+/**
+ * @brief Buffer in device local memory that the device's ResidencyManager
+ *        may move to host visible memory when the device local heap runs
+ *        over budget. The contents are copied over, but the VkBuffer handle
+ *        changes, so look it up with GetVkBuffer each frame instead of
+ *        keeping it, and Touch the buffer in every frame that uses it.
+ *
+ *        Demotion submits a copy to the device's queue from inside
+ *        ResidencyManager::NextFrame, call that from the thread that submits
+ *        to the queue.
+ */
+class ResidentBuffer
+{
+public:
+  /**
+   * @param device
+   * @param size
+   * @param usage Transfer source and destination are added for the upload and the move
+   */
+  ResidentBuffer(Device* device, VkDeviceSize size, VkBufferUsageFlags usage);
+  ~ResidentBuffer();
+
+  ResidentBuffer(const ResidentBuffer&) = delete;
+  ResidentBuffer& operator=(const ResidentBuffer&) = delete;
+
+  VkBuffer GetVkBuffer() const { return buffer; }
+  VkDeviceSize GetSize() const { return size; }
+
+  /**
+   * @brief Heap the buffer started out in and is accounted against
+   */
+  uint32_t GetDeviceLocalHeap() const { return deviceLocalHeap; }
+  bool IsDeviceLocal() const { return deviceLocal; }
+
+  /**
+   * @brief Mark the buffer as used by the current frame
+   */
+  void Touch();
+
+  /**
+   * @brief Copy data into the buffer through a staging buffer, or directly
+   *        once it lives in host visible memory
+   */
+  void Upload(const void* data, VkDeviceSize size);
+  void Download(void* data, VkDeviceSize size);
+
+private:
+  VkDeviceSize demote(VkDeviceSize residentSize);
+  void transfer(const void* uploadData, void* downloadData, VkDeviceSize size);
+
+  /**
+   * @brief Buffer with memory bound from a type with the properties outside
+   *        excludedHeap, VK_NULL_HANDLE if the device has no such memory
+   */
+  VkBuffer createBuffer(VkMemoryPropertyFlags properties, uint32_t excludedHeap, VkDeviceMemory& memory, uint32_t& heapIndex);
+  void copyBuffer(VkBuffer source, VkBuffer destination, VkDeviceSize size);
+
+  Device* device;
+  VkDeviceSize size;
+  VkBufferUsageFlags usage;
+
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  uint32_t deviceLocalHeap;
+  bool deviceLocal;
+
+  ResidencyManager::ResourceId residencyId;
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "ResidencyManager.h"
+
+class Device;
+
+/**
+ * @brief 2D texture with a mip chain in device local memory that the
+ *        device's ResidencyManager may demote by dropping its top mip, one
+ *        level per eviction, down to the smallest level. The VkImage handle
+ *        changes, so look it up with GetVkImage each frame instead of keeping
+ *        it, and Touch the image in every frame that samples it. All levels
+ *        stay in VK_IMAGE_LAYOUT_GENERAL, copies and sampling need no layout
+ *        transitions.
+ *
+ *        Levels are numbered in the full chain, level 0 is the full size one
+ *        whether it is resident or not. Demotion submits a copy from inside
+ *        ResidencyManager::NextFrame, call that from the thread that submits
+ *        to the queues.
+ */
+class ResidentImage
+{
+public:
+  /**
+   * @param device
+   * @param extent
+   * @param format An uncompressed color format
+   * @param mipLevels
+   * @param usage Transfer source and destination are added for the uploads and the demotion
+   */
+  ResidentImage(Device* device, VkExtent2D extent, VkFormat format, uint32_t mipLevels, VkImageUsageFlags usage);
+  ~ResidentImage();
+
+  ResidentImage(const ResidentImage&) = delete;
+  ResidentImage& operator=(const ResidentImage&) = delete;
+
+  VkImage GetVkImage() const { return image; }
+  VkFormat GetFormat() const { return format; }
+  uint32_t GetMipLevels() const { return mipLevels; }
+
+  /**
+   * @brief Largest level still resident, the image's own level 0
+   */
+  uint32_t GetResidentMipLevel() const { return residentLevel; }
+  VkExtent2D GetMipExtent(uint32_t level) const;
+
+  /**
+   * @brief Bytes of a level's texels, tightly packed
+   */
+  VkDeviceSize GetMipSize(uint32_t level) const;
+  uint32_t GetDeviceLocalHeap() const { return heapIndex; }
+
+  /**
+   * @brief Mark the image as used by the current frame
+   */
+  void Touch();
+
+  /**
+   * @brief Bring the dropped levels back, e.g. once the camera comes close
+   *        again. Their contents are undefined until uploaded.
+   */
+  void Restore();
+
+  /**
+   * @brief Copy a resident level's tightly packed texels in or out through
+   *        a staging buffer of GetMipSize(level) bytes
+   */
+  void Upload(uint32_t level, const void* data);
+  void Download(uint32_t level, void* data);
+
+private:
+  VkDeviceSize demote(VkDeviceSize residentSize);
+
+  /**
+   * @brief Replace the image by one holding the levels from newLevel down,
+   *        copying over the levels both hold
+   *
+   * @return VkDeviceSize Memory size of the new image
+   */
+  VkDeviceSize replaceImage(uint32_t newLevel);
+  void transfer(uint32_t level, const void* uploadData, void* downloadData);
+
+  Device* device;
+  VkExtent2D extent;
+  VkFormat format;
+  uint32_t mipLevels;
+  VkImageUsageFlags usage;
+  VkDeviceSize texelSize;
+
+  VkImage image;
+  VkDeviceMemory memory;
+  uint32_t residentLevel;
+  uint32_t heapIndex;
+
+  ResidencyManager::ResourceId residencyId;
+};
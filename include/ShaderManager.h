@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "SpirvReflection.h"
+
+class Device;
+class ShaderManager;
+
+/**
+ * @brief Values for a shader's specialization constants, by constant_id.
+ *        Every scalar constant type is 32 bits wide in SPIR-V for Vulkan, so
+ *        all values are stored as their bit pattern.
+ */
+class SpecializationConstants
+{
+public:
+  SpecializationConstants& Set(uint32_t id, uint32_t value);
+  SpecializationConstants& Set(uint32_t id, int32_t value);
+  SpecializationConstants& Set(uint32_t id, float value);
+  SpecializationConstants& SetBool(uint32_t id, bool value);
+
+  const std::map<uint32_t, uint32_t>& GetValues() const { return values; }
+  uint64_t Hash() const;
+
+private:
+  std::map<uint32_t, uint32_t> values;
+};
+
+/**
+ * @brief A loaded and reflected SPIR-V module with the descriptor set and
+ *        pipeline layouts built from its reflection. Owned by ShaderManager.
+ */
+class ShaderModule
+{
+  friend class ShaderManager;
+
+public:
+  VkShaderModule GetVkShaderModule() const { return vkShaderModule; }
+  const std::string& GetPath() const { return path; }
+  const ShaderReflection& GetReflection() const { return reflection; }
+  const std::vector<VkDescriptorSetLayout>& GetDescriptorSetLayouts() const { return descriptorSetLayouts; }
+  VkPipelineLayout GetPipelineLayout() const { return pipelineLayout; }
+
+private:
+  ShaderModule() = default;
+
+  std::string path;
+  VkShaderModule vkShaderModule = VK_NULL_HANDLE;
+  ShaderReflection reflection;
+  std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+};
+
+/**
+ * @brief One module specialized with a set of constants. The stage create
+ *        info can go straight into a graphics pipeline, compute pipelines
+ *        are built on demand by ShaderManager::GetComputePipeline.
+ */
+class ShaderVariant
+{
+  friend class ShaderManager;
+
+public:
+  const ShaderModule* GetModule() const { return module; }
+  const VkPipelineShaderStageCreateInfo& GetStageCreateInfo() const { return stageCreateInfo; }
+  const SpecializationConstants& GetConstants() const { return constants; }
+
+private:
+  ShaderVariant() = default;
+  ShaderVariant(const ShaderVariant&) = delete;
+  ShaderVariant& operator=(const ShaderVariant&) = delete;
+
+  const ShaderModule* module = nullptr;
+  SpecializationConstants constants;
+
+  // Storage VkSpecializationInfo points into, fixed once the variant is made
+  std::vector<VkSpecializationMapEntry> mapEntries;
+  std::vector<uint32_t> data;
+  VkSpecializationInfo specializationInfo = {};
+  VkPipelineShaderStageCreateInfo stageCreateInfo = {};
+
+  // Built on first request and owned by the manager, which guards it with its mutex
+  mutable VkPipeline computePipeline = VK_NULL_HANDLE;
+};
+
+struct ShaderCacheStats
+{
+  size_t modules = 0;
+  size_t variants = 0;
+  // Requests answered by an existing variant instead of a new one
+  size_t variantHits = 0;
+  size_t computePipelines = 0;
+  size_t descriptorSetLayouts = 0;
+  size_t pipelineLayouts = 0;
+  size_t layoutHits = 0;
+};
+
+/**
+ * @brief Per-device cache of shader modules, layouts and specialized
+ *        variants. SPIR-V is memory mapped and reflected on load, so nobody
+ *        writes descriptor set layouts by hand. Layouts are shared between
+ *        modules with the same bindings, and variants are deduplicated by a
+ *        hash of module and constants, so one SPIR-V binary serves every
+ *        workgroup size or unroll count a device is tuned for.
+ */
+class ShaderManager
+{
+  friend class Device;
+
+public:
+  /**
+   * @brief Load a SPIR-V file, or return the module already loaded from it
+   */
+  const ShaderModule* LoadModule(const std::string& path);
+
+  /**
+   * @brief Module specialized with the constants. Constants the shader does
+   *        not declare are ignored, ones left out keep their default.
+   */
+  const ShaderVariant* GetVariant(const ShaderModule* module, const SpecializationConstants& constants = SpecializationConstants());
+
+  /**
+   * @brief Compute pipeline for a variant of a compute shader, created on first use
+   */
+  VkPipeline GetComputePipeline(const ShaderVariant* variant);
+
+  VkDescriptorSetLayout GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+  VkPipelineLayout GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+  /**
+   * @brief Pipeline layout for several stages, e.g. vertex and fragment,
+   *        merging their bindings and push constant ranges
+   */
+  VkPipelineLayout GetPipelineLayout(const std::vector<const ShaderModule*>& modules);
+
+  ShaderCacheStats GetStats() const;
+
+private:
+  explicit ShaderManager(Device* device);
+  ~ShaderManager();
+
+  VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+  VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges);
+  VkPipelineLayout getPipelineLayout(const std::vector<std::vector<VkDescriptorSetLayoutBinding>>& sets, const std::vector<VkPushConstantRange>& pushConstantRanges);
+
+  template <typename T>
+  struct CacheEntry
+  {
+    T handle;
+    std::vector<uint8_t> key;
+  };
+
+  Device* device;
+
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, ShaderModule*> modules;
+  std::unordered_multimap<uint64_t, ShaderVariant*> variants;
+  std::unordered_multimap<uint64_t, CacheEntry<VkDescriptorSetLayout>> descriptorSetLayouts;
+  std::unordered_multimap<uint64_t, CacheEntry<VkPipelineLayout>> pipelineLayouts;
+  ShaderCacheStats stats;
+};
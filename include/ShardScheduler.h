@@ -0,0 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Device;
+
+/**
+ * @brief Work for items [begin, end) on one device. Called from that
+ *        device's worker thread, never from two threads for the same device
+ *        at once, so per-device state such as a ComputePrimitives can be
+ *        indexed by deviceIndex without locking.
+ */
+using ShardFunction = std::function<void(unsigned int deviceIndex, Device* device, size_t begin, size_t end)>;
+
+struct ShardDeviceStats
+{
+  size_t chunks = 0;
+  size_t items = 0;
+  // Chunks taken from another device's queue once this one ran dry
+  size_t stolenChunks = 0;
+  double busyMilliseconds = 0.0;
+  double elapsedMilliseconds = 0.0;
+  // Busy time over the wall time of the runs
+  double utilization = 0.0;
+  // Measured items per millisecond, 0 until the device ran a chunk
+  double throughput = 0.0;
+  // Share of the next run's items
+  double weight = 0.0;
+};
+
+/**
+ * @brief Splits batched jobs over several devices. Each run hands every
+ *        device a share of the items proportional to its measured
+ *        throughput, cut into chunks on a per-device queue. A device that
+ *        finishes its queue steals chunks from the back of the fullest
+ *        remaining queue, so a bad estimate or a device slowed down by other
+ *        work costs at most a chunk of imbalance.
+ *
+ *        One worker thread per device lives as long as the scheduler.
+ */
+class ShardScheduler
+{
+public:
+  explicit ShardScheduler(const std::vector<Device*>& devices, unsigned int chunksPerDevice = 8);
+  ~ShardScheduler();
+
+  ShardScheduler(const ShardScheduler&) = delete;
+  ShardScheduler& operator=(const ShardScheduler&) = delete;
+
+  /**
+   * @brief Run function over itemCount items and wait for every chunk.
+   *        The first exception thrown by a chunk is rethrown here after the
+   *        remaining chunks are dropped. Runs are serialized.
+   */
+  void Run(size_t itemCount, const ShardFunction& function);
+
+  const std::vector<Device*>& GetDevices() const { return devices; }
+  std::vector<ShardDeviceStats> GetStats() const;
+
+  /**
+   * @brief Clear the counters, the throughput estimates are kept
+   */
+  void ResetStats();
+
+private:
+  struct Chunk
+  {
+    size_t begin;
+    size_t end;
+  };
+
+  struct Worker
+  {
+    std::thread thread;
+    std::deque<Chunk> chunks;
+    size_t queuedItems = 0;
+
+    // Counters of the current run, folded into throughput when it ends
+    size_t runItems = 0;
+    double runBusyMilliseconds = 0.0;
+
+    ShardDeviceStats stats;
+  };
+
+  void workerLoop(unsigned int index);
+  bool takeChunk(unsigned int index, Chunk& chunk, bool& stolen);
+  void splitItems(size_t itemCount);
+  void updateThroughput();
+
+  std::vector<Device*> devices;
+  std::vector<Worker> workers;
+  unsigned int chunksPerDevice;
+
+  std::mutex runMutex;
+
+  mutable std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable runFinished;
+  unsigned long long generation;
+  bool stopping;
+  const ShardFunction* function;
+  size_t pendingChunks;
+  std::exception_ptr error;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/**
+ * @brief What a pipeline layout needs to know about a shader, read straight
+ *        from its SPIR-V. Covers descriptor bindings, push constants,
+ *        specialization constant ids and the compute workgroup size.
+ */
+struct ShaderReflection
+{
+  VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+  std::string entryPoint;
+
+  // Indexed by set number, sets the shader does not use are left empty
+  std::vector<std::vector<VkDescriptorSetLayoutBinding>> descriptorSets;
+
+  // At most one range, SPIR-V allows a single push constant block per entry point
+  std::vector<VkPushConstantRange> pushConstantRanges;
+
+  std::vector<uint32_t> specializationConstantIds;
+
+  // Compute workgroup size, the default value where it is a specialization constant
+  uint32_t localSize[3] = { 0, 0, 0 };
+  // Specialization constant ids of the workgroup size, -1 where it is literal
+  int32_t localSizeIds[3] = { -1, -1, -1 };
+};
+
+/**
+ * @brief Reflect a SPIR-V binary with a single entry point. Throws
+ *        std::runtime_error on malformed input or unsupported stages.
+ */
+ShaderReflection ReflectSpirv(const uint32_t* code, size_t wordCount);
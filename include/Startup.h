@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "QueueFlags.h"
+
+class Instance;
+class Device;
+class SwapChain;
+
+/**
+ * Wall time of each startup phase. In the parallel path the window phase
+ * overlaps the instance, physical device and device phases, so the total is
+ * less than their sum.
+ */
+struct StartupTimings
+{
+  double glfwMilliseconds = 0.0;
+  double windowMilliseconds = 0.0;
+  double instanceMilliseconds = 0.0;
+  double physicalDeviceMilliseconds = 0.0;
+  double deviceMilliseconds = 0.0;
+  double surfaceMilliseconds = 0.0;
+  double swapChainMilliseconds = 0.0;
+  double totalMilliseconds = 0.0;
+};
+
+struct StartupOptions
+{
+  const char* applicationName = "Demo";
+  int width = 800;
+  int height = 800;
+  std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+  QueueFlagBits requiredQueues = QueueFlagBit::ComputeBit | QueueFlagBit::GraphicsBit | QueueFlagBit::PresentBit | QueueFlagBit::TransferBit;
+  VkPhysicalDeviceFeatures deviceFeatures = {};
+  unsigned int swapChainBuffers = 3;
+
+  // Create the instance and device on a worker thread while the main thread creates the window
+  bool parallel = true;
+};
+
+struct StartupContext
+{
+  Instance* instance = nullptr;
+  Device* device = nullptr;
+  VkSurfaceKHR surface = VK_NULL_HANDLE;
+  SwapChain* swapChain = nullptr;
+  StartupTimings timings;
+};
+
+/**
+ * @brief Bring up GLFW, the window, instance, device and swap chain. Must be
+ *        called from the main thread, GLFW creates windows there only.
+ */
+StartupContext InitializeVulkan(const StartupOptions& options);
+
+/**
+ * @brief Destroy everything InitializeVulkan created, window included
+ */
+void DestroyVulkan(StartupContext& context);
@@ -3,6 +3,7 @@
 #include <vector>
 #include "Device.h"
 
+struct GLFWwindow;
 class Device;
 class SwapChain
 {
@@ -11,26 +12,59 @@ class SwapChain
 public:
   ~SwapChain();
 
-private:
-  SwapChain(Device* device, VkSurfaceKHR vkSurface, unsigned int numBuffers);
-  void Create();
-  void Destroy();
+  /**
+   * @brief Acquire the next image, signalling the image available semaphore.
+   *        An out of date swap chain is recreated and acquired again.
+   * 
+   * @return VkResult VK_SUCCESS or VK_SUBOPTIMAL_KHR, VK_NOT_READY while the
+   *         window is minimized, nothing was acquired and the swap chain must
+   *         be skipped this frame
+   */
+  VkResult Acquire();
+
+  /**
+   * @brief Recreate the swap chain for the current surface size, e.g. after
+   *        the window was resized. While the window is minimized the surface
+   *        has a zero extent, recreation is then deferred to the next Acquire.
+   *
+   * @return true The swap chain was recreated
+   */
+  bool Recreate();
+
   VkSwapchainKHR GetVkSwapChain() const;
   VkFormat GetVkImageFormat() const;
   VkExtent2D GetVkExtent() const;
+  /**
+   * @brief Color attachment, plus transfer destination if the surface supports it
+   */
+  VkImageUsageFlags GetVkImageUsage() const;
   uint32_t GetIndex() const;
+  uint32_t GetCount() const;
+  VkImage GetVkImage(uint32_t index) const;
+  VkSurfaceKHR GetVkSurface() const;
+  GLFWwindow* GetWindow() const;
+  VkSemaphore GetImageAvailableVkSemaphore() const;
+  VkSemaphore GetRenderFinishedVkSemaphore() const;
+
+private:
+  SwapChain(Device* device, VkSurfaceKHR vkSurface, unsigned int numBuffers, GLFWwindow* window);
+  bool Create(VkSwapchainKHR oldSwapChain);
+  void Destroy();
 
   Device* device;
   VkSurfaceKHR vkSurface;
   unsigned int numBuffers;
+  GLFWwindow* window;
   VkSwapchainKHR vkSwapChain;
+  uint32_t imageIndex = 0;
+  bool recreatePending;
 
   std::vector<VkImage> vkSwapChainImages;
 
   VkFormat vkSwapChainImageFormat;
   VkExtent2D vkSwapChainExtent;
+  VkImageUsageFlags vkSwapChainImageUsage;
 
   VkSemaphore imageAvailableSemaphore;
   VkSemaphore renderFinishedSemaphore;
 };
-
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class Device;
+
+struct SyncObjectStats
+{
+  // Handed out and not yet released
+  size_t live = 0;
+  size_t peak = 0;
+  // Vulkan objects created over the pool's lifetime, low means good recycling
+  size_t created = 0;
+  size_t available = 0;
+};
+
+/**
+ * @brief Per-device pools of fences, binary semaphores and events. Released
+ *        objects are recycled instead of destroyed, fences and events are
+ *        reset in bulk the next time the pool runs dry or on Recycle().
+ *        Objects still out when the pool is destroyed are reported as leaks.
+ *        Debug builds throw on releasing an object twice or one from
+ *        another pool.
+ */
+class SyncPool
+{
+  friend class Device;
+
+public:
+  /**
+   * @brief Get an unsignaled fence
+   */
+  VkFence AcquireFence();
+
+  /**
+   * @brief Return a fence. It may still be signaled but must not be in use
+   *        by a pending submission.
+   */
+  void ReleaseFence(VkFence fence);
+
+  /**
+   * @brief Get an unsignaled binary semaphore
+   */
+  VkSemaphore AcquireSemaphore();
+
+  /**
+   * @brief Return a binary semaphore with no pending signal or wait
+   */
+  void ReleaseSemaphore(VkSemaphore semaphore);
+
+  /**
+   * @brief Get an unset event
+   */
+  VkEvent AcquireEvent();
+  void ReleaseEvent(VkEvent event);
+
+  /**
+   * @brief Reset every released fence and event now instead of on demand,
+   *        e.g. at a point in the frame where the cost is hidden
+   */
+  void Recycle();
+
+  SyncObjectStats GetFenceStats() const;
+  SyncObjectStats GetSemaphoreStats() const;
+  SyncObjectStats GetEventStats() const;
+
+private:
+  template <typename T>
+  struct ObjectPool
+  {
+    std::vector<T> objects;
+    std::vector<T> available;
+    std::vector<T> pendingReset;
+    SyncObjectStats stats;
+#ifndef NDEBUG
+    // Handed out objects, catches double and foreign releases
+    std::unordered_set<T> acquired;
+#endif
+  };
+
+  explicit SyncPool(Device* device);
+  ~SyncPool();
+
+  void resetFences();
+  void resetEvents();
+
+  template <typename T>
+  SyncObjectStats getStats(const ObjectPool<T>& pool) const;
+
+  Device* device;
+
+  mutable std::mutex mutex;
+  ObjectPool<VkFence> fences;
+  ObjectPool<VkSemaphore> semaphores;
+  ObjectPool<VkEvent> events;
+};
@@ -6,6 +6,20 @@
 struct GLFWwindow;
 GLFWwindow* GetGLFWWindow();
 
+/**
+ * Initialize GLFW without creating a window, InitializeWindow does both.
+ * Lets the Vulkan instance be created while the window is still being made.
+ */
+void InitializeGLFW();
 void InitializeWindow(int width, int height, const char* title);
 bool ShouldQuit();
+bool IsMinimized();
 void DestroyWindow();
+
+/**
+ * Additional windows next to the one from InitializeWindow, e.g. one per
+ * output view. They are destroyed together with it by DestroyWindow.
+ */
+GLFWwindow* CreateGLFWWindow(int width, int height, const char* title);
+bool ShouldClose(GLFWwindow* window);
+bool IsMinimized(GLFWwindow* window);
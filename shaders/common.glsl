@@ -0,0 +1,91 @@
+// Declarations shared by the compute primitive kernels. Workgroup size and
+// items per thread are specialization constants so the host can tune the
+// tile size per device without rebuilding the SPIR-V.
+
+#ifdef USE_SUBGROUP
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#endif
+
+layout(constant_id = 0) const uint WORKGROUP_SIZE = 256;
+layout(constant_id = 1) const uint ITEMS_PER_THREAD = 8;
+
+layout(local_size_x_id = 0) in;
+
+const uint TILE_SIZE = WORKGROUP_SIZE * ITEMS_PER_THREAD;
+
+layout(push_constant) uniform Parameters
+{
+  uint count;
+  // Treat every input value as (value != 0), used to count selected elements
+  uint countNonZero;
+  // Radix sort: lowest bit of the digit sorted by this pass
+  uint shift;
+  // Radix sort: number of tiles in the pass
+  uint tileCount;
+  // Add a per-workgroup offset from the offsets buffer
+  uint useOffsets;
+} parameters;
+
+shared uint scanScratch[WORKGROUP_SIZE];
+shared uint scanTotal;
+
+uint loadValue(uint value)
+{
+  return parameters.countNonZero != 0 ? uint(value != 0) : value;
+}
+
+/**
+ * Exclusive prefix sum of one value per invocation across the workgroup.
+ * Must be called from uniform control flow.
+ */
+uint workgroupExclusiveScan(uint value, out uint total)
+{
+#ifdef USE_SUBGROUP
+  uint inclusive = subgroupInclusiveAdd(value);
+  uint subgroupTotal = subgroupAdd(value);
+  if (subgroupElect()) {
+    scanScratch[gl_SubgroupID] = subgroupTotal;
+  }
+  barrier();
+
+  // First subgroup scans the per-subgroup totals, possibly more of them than it has lanes
+  if (gl_SubgroupID == 0) {
+    uint carry = 0;
+    for (uint base = 0; base < gl_NumSubgroups; base += gl_SubgroupSize) {
+      uint index = base + gl_SubgroupInvocationID;
+      uint partial = index < gl_NumSubgroups ? scanScratch[index] : 0;
+      uint partialInclusive = subgroupInclusiveAdd(partial);
+      if (index < gl_NumSubgroups) {
+        scanScratch[index] = carry + partialInclusive - partial;
+      }
+      carry += subgroupAdd(partial);
+    }
+    if (subgroupElect()) {
+      scanTotal = carry;
+    }
+  }
+  barrier();
+
+  total = scanTotal;
+  uint exclusive = scanScratch[gl_SubgroupID] + inclusive - value;
+  barrier();
+  return exclusive;
+#else
+  uint id = gl_LocalInvocationID.x;
+  scanScratch[id] = value;
+  barrier();
+
+  for (uint offset = 1; offset < WORKGROUP_SIZE; offset <<= 1) {
+    uint addend = id >= offset ? scanScratch[id - offset] : 0;
+    barrier();
+    scanScratch[id] += addend;
+    barrier();
+  }
+
+  total = scanScratch[WORKGROUP_SIZE - 1];
+  uint exclusive = scanScratch[id] - value;
+  barrier();
+  return exclusive;
+#endif
+}
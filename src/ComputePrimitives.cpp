@@ -0,0 +1,577 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "ComputePrimitives.h"
+#include "Device.h"
+#include "Instance.h"
+#include "ShaderManager.h"
+
+#ifndef SHADER_DIR
+#define SHADER_DIR "shaders"
+#endif
+
+namespace
+{
+  constexpr uint32_t RADIX_BITS = 4;
+  constexpr uint32_t RADIX_DIGITS = 1 << RADIX_BITS;
+
+  // Starting points for tuning, see ComputePrimitives::Reserve
+  constexpr uint32_t GENERAL_WORKGROUP_SIZE = 256;
+  constexpr uint32_t RADIX_WORKGROUP_SIZE = 128;
+  constexpr uint32_t ITEMS_PER_THREAD = 8;
+
+  constexpr uint32_t DESCRIPTOR_POOL_SETS = 256;
+  constexpr uint32_t MAX_KERNEL_BINDINGS = 5;
+
+  // Specialization constant ids, see shaders/common.glsl
+  constexpr uint32_t WORKGROUP_SIZE_ID = 0;
+  constexpr uint32_t ITEMS_PER_THREAD_ID = 1;
+
+  const char* KERNEL_NAMES[] = { "reduce", "scan", "compact", "radix_count", "radix_scatter" };
+
+  uint32_t divideRoundUp(uint64_t value, uint64_t divisor) {
+    return static_cast<uint32_t>((value + divisor - 1) / divisor);
+  }
+
+  void computeBarrier(VkCommandBuffer commandBuffer) {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  /**
+   * @brief Elements needed to hold every level of block sums when scanning
+   *        count elements with the given tile size
+   */
+  VkDeviceSize partialsCapacity(uint64_t count, uint32_t tileSize, uint32_t alignment) {
+    VkDeviceSize capacity = alignment;
+    while (count > tileSize) {
+      count = divideRoundUp(count, tileSize);
+      capacity += (count + alignment - 1) / alignment * alignment;
+    }
+    return capacity;
+  }
+} // namespace
+
+
+ComputePrimitives::ComputePrimitives(Device* device)
+  : device(device), useSubgroups(false), subgroupSize(1), currentDescriptorPool(0),
+    commandPool(VK_NULL_HANDLE), commandBuffer(VK_NULL_HANDLE), reservedCount(0)
+{
+  limits = device->GetProperties().limits;
+
+  // --- Check for subgroup arithmetic in compute shaders ---
+  if (device->GetProperties().apiVersion >= VK_API_VERSION_1_1) {
+    VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+    subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(device->GetPhysicalDevice(), &properties);
+
+    const VkSubgroupFeatureFlags requiredOperations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+    useSubgroups = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+      (subgroupProperties.supportedOperations & requiredOperations) == requiredOperations;
+    subgroupSize = std::max(1u, subgroupProperties.subgroupSize);
+  }
+
+  // --- Shader modules, reflected and cached by the device ---
+  ShaderManager* shaderManager = device->GetShaderManager();
+  for (unsigned int kernel = 0; kernel < KernelCount; kernel++)
+  {
+    std::string path = std::string(SHADER_DIR) + "/" + KERNEL_NAMES[kernel] + (useSubgroups ? ".subgroup.spv" : ".spv");
+    modules[kernel] = shaderManager->LoadModule(path);
+
+    const ShaderReflection& reflection = modules[kernel]->GetReflection();
+    if (reflection.descriptorSets.size() != 1 || reflection.descriptorSets[0].size() > MAX_KERNEL_BINDINGS ||
+      reflection.pushConstantRanges.size() != 1 || reflection.pushConstantRanges[0].size != sizeof(KernelParameters)) {
+      throw std::runtime_error("Unexpected interface in compute shader " + path);
+    }
+  }
+  pipelines.fill(VK_NULL_HANDLE);
+
+  // --- Command buffer on the compute queue ---
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = device->GetQueueIndex(QueueFlags::Compute);
+  if (vkCreateCommandPool(device->GetVkDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create command pool");
+  }
+
+  VkCommandBufferAllocateInfo allocateInfo = {};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocateInfo.commandPool = commandPool;
+  allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocateInfo.commandBufferCount = 1;
+  if (vkAllocateCommandBuffers(device->GetVkDevice(), &allocateInfo, &commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate command buffer");
+  }
+}
+
+ComputePrimitives::~ComputePrimitives() {
+  VkDevice vkDevice = device->GetVkDevice();
+
+  DestroyBuffer(partials);
+  DestroyBuffer(tileCounts);
+  DestroyBuffer(scratchKeys);
+  DestroyBuffer(scratchValues);
+
+  for (VkDescriptorPool pool : descriptorPools)
+  {
+    vkDestroyDescriptorPool(vkDevice, pool, nullptr);
+  }
+  vkDestroyCommandPool(vkDevice, commandPool, nullptr);
+}
+
+ComputeBuffer ComputePrimitives::CreateBuffer(VkDeviceSize size, VkMemoryPropertyFlags properties) {
+  ComputeBuffer buffer;
+  buffer.size = size;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(device->GetVkDevice(), &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create buffer");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device->GetVkDevice(), buffer.buffer, &requirements);
+  buffer.memory = device->AllocateMemory(requirements, properties);
+  vkBindBufferMemory(device->GetVkDevice(), buffer.buffer, buffer.memory, 0);
+
+  if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    vkMapMemory(device->GetVkDevice(), buffer.memory, 0, size, 0, &buffer.mapped);
+  }
+
+  return buffer;
+}
+
+void ComputePrimitives::DestroyBuffer(ComputeBuffer& buffer) {
+  if (buffer.buffer == VK_NULL_HANDLE) {
+    return;
+  }
+
+  if (buffer.mapped) {
+    vkUnmapMemory(device->GetVkDevice(), buffer.memory);
+  }
+  vkDestroyBuffer(device->GetVkDevice(), buffer.buffer, nullptr);
+  device->FreeMemory(buffer.memory);
+  buffer = ComputeBuffer();
+}
+
+void ComputePrimitives::Upload(const ComputeBuffer& buffer, const void* data, VkDeviceSize size) {
+  if (buffer.mapped) {
+    memcpy(buffer.mapped, data, size);
+    return;
+  }
+
+  ComputeBuffer staging = CreateBuffer(size, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  memcpy(staging.mapped, data, size);
+  Execute([&](VkCommandBuffer commandBuffer) {
+    VkBufferCopy region = { 0, 0, size };
+    vkCmdCopyBuffer(commandBuffer, staging.buffer, buffer.buffer, 1, &region);
+  });
+  DestroyBuffer(staging);
+}
+
+void ComputePrimitives::Download(const ComputeBuffer& buffer, void* data, VkDeviceSize size) {
+  if (buffer.mapped) {
+    memcpy(data, buffer.mapped, size);
+    return;
+  }
+
+  ComputeBuffer staging = CreateBuffer(size, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  Execute([&](VkCommandBuffer commandBuffer) {
+    VkBufferCopy region = { 0, 0, size };
+    vkCmdCopyBuffer(commandBuffer, buffer.buffer, staging.buffer, 1, &region);
+  });
+  memcpy(data, staging.mapped, size);
+  DestroyBuffer(staging);
+}
+
+void ComputePrimitives::Reserve(uint32_t maxCount) {
+  if (maxCount <= reservedCount && pipelines[0] != VK_NULL_HANDLE) {
+    return;
+  }
+
+  // --- Tune tile sizes for the device ---
+  auto fitWorkgroup = [this](uint32_t preferred) {
+    uint32_t size = std::min(preferred, std::min(limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations));
+    if (useSubgroups && size > subgroupSize) {
+      // Whole subgroups only, partial ones waste lanes in every scan
+      size -= size % subgroupSize;
+    }
+    return size;
+  };
+  auto fitItems = [this](uint64_t count, uint32_t workgroupSize) {
+    // Grow the tile until the dispatch fits the group count limit
+    uint32_t items = ITEMS_PER_THREAD;
+    while (divideRoundUp(count, uint64_t(workgroupSize) * items) > limits.maxComputeWorkGroupCount[0]) {
+      items *= 2;
+    }
+    return items;
+  };
+
+  // Radix scatter keeps a digit table per invocation in shared memory
+  radixTuning.workgroupSize = fitWorkgroup(RADIX_WORKGROUP_SIZE);
+  while (radixTuning.workgroupSize > RADIX_DIGITS &&
+    (RADIX_DIGITS + 1) * radixTuning.workgroupSize * sizeof(uint32_t) + sizeof(uint32_t) > limits.maxComputeSharedMemorySize) {
+    radixTuning.workgroupSize /= 2;
+  }
+  radixTuning.itemsPerThread = fitItems(maxCount, radixTuning.workgroupSize);
+
+  uint32_t radixTiles = divideRoundUp(maxCount, GetRadixTileSize());
+  uint64_t maxScanCount = std::max<uint64_t>(maxCount, uint64_t(RADIX_DIGITS) * radixTiles);
+
+  generalTuning.workgroupSize = fitWorkgroup(GENERAL_WORKGROUP_SIZE);
+  generalTuning.itemsPerThread = fitItems(maxScanCount, generalTuning.workgroupSize);
+
+  selectPipelines();
+
+  // --- Scratch buffers ---
+  DestroyBuffer(partials);
+  DestroyBuffer(tileCounts);
+  DestroyBuffer(scratchKeys);
+  DestroyBuffer(scratchValues);
+
+  uint32_t alignment = static_cast<uint32_t>(std::max<VkDeviceSize>(1, limits.minStorageBufferOffsetAlignment / sizeof(uint32_t)));
+  VkDeviceSize partialsCount = partialsCapacity(maxScanCount, GetTileSize(), alignment);
+
+  partials = CreateBuffer(partialsCount * sizeof(uint32_t), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  tileCounts = CreateBuffer(std::max(1u, RADIX_DIGITS * radixTiles) * sizeof(uint32_t), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  scratchKeys = CreateBuffer(std::max(1u, maxCount) * sizeof(uint32_t), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  scratchValues = CreateBuffer(std::max(1u, maxCount) * sizeof(uint32_t), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  reservedCount = maxCount;
+}
+
+void ComputePrimitives::Execute(const std::function<void(VkCommandBuffer)>& record) {
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  vkResetCommandBuffer(commandBuffer, 0);
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+  record(commandBuffer);
+
+  // Make the results visible to mapped host reads
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+    0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to record compute command buffer");
+  }
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+
+  SyncPool* syncPool = device->GetSyncPool();
+  VkFence fence = syncPool->AcquireFence();
+  if (vkQueueSubmit(device->GetQueue(QueueFlags::Compute), 1, &submitInfo, fence) != VK_SUCCESS) {
+    syncPool->ReleaseFence(fence);
+    throw std::runtime_error("Failed to submit compute command buffer");
+  }
+  if (vkWaitForFences(device->GetVkDevice(), 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+    // The fence may still be pending, so it is not handed back to the pool
+    throw std::runtime_error("Failed to wait for compute command buffer");
+  }
+  syncPool->ReleaseFence(fence);
+
+  for (VkDescriptorPool pool : descriptorPools)
+  {
+    vkResetDescriptorPool(device->GetVkDevice(), pool, 0);
+  }
+  currentDescriptorPool = 0;
+}
+
+void ComputePrimitives::RecordReduce(VkCommandBuffer commandBuffer, const ComputeBuffer& input, const ComputeBuffer& result, uint32_t count) {
+  if (count > reservedCount) {
+    throw std::runtime_error("Reduce count exceeds ComputePrimitives::Reserve");
+  }
+  if (count == 0) {
+    vkCmdFillBuffer(commandBuffer, result.buffer, 0, sizeof(uint32_t), 0);
+    computeBarrier(commandBuffer);
+    return;
+  }
+
+  // Reduce tiles to block sums until one tile is left
+  BufferRange source = { input.buffer, 0, VK_WHOLE_SIZE };
+  VkDeviceSize partialsOffset = 0;
+  uint32_t remaining = count;
+  while (true) {
+    uint32_t groupCount = divideRoundUp(remaining, GetTileSize());
+    BufferRange destination = groupCount == 1
+      ? BufferRange{ result.buffer, 0, VK_WHOLE_SIZE }
+      : partialsRange(partialsOffset, groupCount);
+
+    dispatch(commandBuffer, Reduce, { source, destination }, { remaining, 0, 0, 0, 0 }, groupCount);
+    if (groupCount == 1) {
+      break;
+    }
+
+    source = destination;
+    remaining = groupCount;
+    partialsOffset += destination.range / sizeof(uint32_t);
+  }
+}
+
+void ComputePrimitives::RecordExclusiveScan(VkCommandBuffer commandBuffer, const ComputeBuffer& input, const ComputeBuffer& output, uint32_t count) {
+  if (count > reservedCount) {
+    throw std::runtime_error("Scan count exceeds ComputePrimitives::Reserve");
+  }
+  if (count == 0) {
+    return;
+  }
+
+  recordScan(commandBuffer, { input.buffer, 0, VK_WHOLE_SIZE }, { output.buffer, 0, VK_WHOLE_SIZE }, count, 0);
+}
+
+void ComputePrimitives::RecordCompact(VkCommandBuffer commandBuffer, const ComputeBuffer& values, const ComputeBuffer& flags,
+  const ComputeBuffer& output, const ComputeBuffer& resultCount, uint32_t count) {
+  if (count > reservedCount) {
+    throw std::runtime_error("Compact count exceeds ComputePrimitives::Reserve");
+  }
+  if (count == 0) {
+    vkCmdFillBuffer(commandBuffer, resultCount.buffer, 0, sizeof(uint32_t), 0);
+    computeBarrier(commandBuffer);
+    return;
+  }
+
+  uint32_t tileCount = divideRoundUp(count, GetTileSize());
+  BufferRange offsets = partialsRange(0, 1);
+  uint32_t useOffsets = 0;
+
+  // Scan the per-tile count of selected elements into each tile's output offset
+  if (tileCount > 1) {
+    offsets = partialsRange(0, tileCount);
+    dispatch(commandBuffer, Reduce, { { flags.buffer, 0, VK_WHOLE_SIZE }, offsets }, { count, 1, 0, 0, 0 }, tileCount);
+    recordScan(commandBuffer, offsets, offsets, tileCount, offsets.range / sizeof(uint32_t));
+    useOffsets = 1;
+  }
+
+  dispatch(commandBuffer, Compact, {
+      { values.buffer, 0, VK_WHOLE_SIZE },
+      { flags.buffer, 0, VK_WHOLE_SIZE },
+      offsets,
+      { output.buffer, 0, VK_WHOLE_SIZE },
+      { resultCount.buffer, 0, VK_WHOLE_SIZE },
+    }, { count, 0, 0, 0, useOffsets }, tileCount);
+}
+
+void ComputePrimitives::RecordRadixSort(VkCommandBuffer commandBuffer, const ComputeBuffer& keys, const ComputeBuffer& values, uint32_t count, uint32_t keyBits) {
+  if (count > reservedCount) {
+    throw std::runtime_error("Radix sort count exceeds ComputePrimitives::Reserve");
+  }
+  if (count < 2) {
+    return;
+  }
+
+  uint32_t passCount = divideRoundUp(std::min(keyBits, 32u), RADIX_BITS);
+  uint32_t tileCount = divideRoundUp(count, GetRadixTileSize());
+
+  const BufferRange keyBuffers[] = { { keys.buffer, 0, VK_WHOLE_SIZE }, { scratchKeys.buffer, 0, VK_WHOLE_SIZE } };
+  const BufferRange valueBuffers[] = { { values.buffer, 0, VK_WHOLE_SIZE }, { scratchValues.buffer, 0, VK_WHOLE_SIZE } };
+  const BufferRange table = { tileCounts.buffer, 0, RADIX_DIGITS * tileCount * sizeof(uint32_t) };
+
+  for (uint32_t pass = 0; pass < passCount; pass++)
+  {
+    uint32_t source = pass & 1;
+    uint32_t destination = source ^ 1;
+    KernelParameters parameters = { count, 0, pass * RADIX_BITS, tileCount, 0 };
+
+    dispatch(commandBuffer, RadixCount, { keyBuffers[source], table }, parameters, tileCount);
+    recordScan(commandBuffer, table, table, RADIX_DIGITS * tileCount, 0);
+    dispatch(commandBuffer, RadixScatter, {
+        keyBuffers[source], valueBuffers[source], table, keyBuffers[destination], valueBuffers[destination],
+      }, parameters, tileCount);
+  }
+
+  // An odd number of passes leaves the result in the scratch buffers
+  if (passCount & 1) {
+    VkBufferCopy region = { 0, 0, count * sizeof(uint32_t) };
+    vkCmdCopyBuffer(commandBuffer, scratchKeys.buffer, keys.buffer, 1, &region);
+    vkCmdCopyBuffer(commandBuffer, scratchValues.buffer, values.buffer, 1, &region);
+    computeBarrier(commandBuffer);
+  }
+}
+
+void ComputePrimitives::selectPipelines() {
+  ShaderManager* shaderManager = device->GetShaderManager();
+  for (unsigned int kernel = 0; kernel < KernelCount; kernel++)
+  {
+    const Tuning& tuning = (kernel == RadixCount || kernel == RadixScatter) ? radixTuning : generalTuning;
+
+    // Variants are cached, re-tuning to a size seen before costs no pipeline compile
+    SpecializationConstants constants;
+    constants.Set(WORKGROUP_SIZE_ID, tuning.workgroupSize).Set(ITEMS_PER_THREAD_ID, tuning.itemsPerThread);
+    pipelines[kernel] = shaderManager->GetComputePipeline(shaderManager->GetVariant(modules[kernel], constants));
+  }
+}
+
+VkDescriptorSet ComputePrimitives::allocateDescriptorSet(Kernel kernel) {
+  VkDescriptorSetAllocateInfo allocateInfo = {};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocateInfo.descriptorSetCount = 1;
+  allocateInfo.pSetLayouts = &modules[kernel]->GetDescriptorSetLayouts()[0];
+
+  // Move on to the next pool, creating it if needed, whenever one runs out
+  while (true) {
+    if (currentDescriptorPool == descriptorPools.size()) {
+      VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DESCRIPTOR_POOL_SETS * MAX_KERNEL_BINDINGS };
+
+      VkDescriptorPoolCreateInfo poolInfo = {};
+      poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+      poolInfo.maxSets = DESCRIPTOR_POOL_SETS;
+      poolInfo.poolSizeCount = 1;
+      poolInfo.pPoolSizes = &poolSize;
+
+      VkDescriptorPool pool;
+      if (vkCreateDescriptorPool(device->GetVkDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create descriptor pool");
+      }
+      descriptorPools.push_back(pool);
+    }
+
+    allocateInfo.descriptorPool = descriptorPools[currentDescriptorPool];
+    VkDescriptorSet descriptorSet;
+    VkResult result = vkAllocateDescriptorSets(device->GetVkDevice(), &allocateInfo, &descriptorSet);
+    if (result == VK_SUCCESS) {
+      return descriptorSet;
+    }
+    if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+      throw std::runtime_error("Failed to allocate descriptor set");
+    }
+    currentDescriptorPool++;
+  }
+}
+
+void ComputePrimitives::dispatch(VkCommandBuffer commandBuffer, Kernel kernel, const std::vector<BufferRange>& buffers,
+  const KernelParameters& parameters, uint32_t groupCount) {
+  if (groupCount > limits.maxComputeWorkGroupCount[0]) {
+    throw std::runtime_error("Compute dispatch exceeds the workgroup count limit");
+  }
+
+  VkDescriptorSet descriptorSet = allocateDescriptorSet(kernel);
+
+  std::vector<VkDescriptorBufferInfo> bufferInfos(buffers.size());
+  std::vector<VkWriteDescriptorSet> writes(buffers.size());
+  for (uint32_t i = 0; i < buffers.size(); i++)
+  {
+    bufferInfos[i] = { buffers[i].buffer, buffers[i].offset, buffers[i].range };
+
+    writes[i] = {};
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = descriptorSet;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = &bufferInfos[i];
+  }
+  vkUpdateDescriptorSets(device->GetVkDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[kernel]);
+  VkPipelineLayout pipelineLayout = modules[kernel]->GetPipelineLayout();
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(KernelParameters), &parameters);
+  vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+  computeBarrier(commandBuffer);
+}
+
+void ComputePrimitives::recordScan(VkCommandBuffer commandBuffer, BufferRange input, BufferRange output, uint32_t count, VkDeviceSize partialsOffset) {
+  uint32_t tileCount = divideRoundUp(count, GetTileSize());
+  if (tileCount == 1) {
+    dispatch(commandBuffer, Scan, { input, partialsRange(0, 1), output }, { count, 0, 0, 0, 0 }, 1);
+    return;
+  }
+
+  // Reduce-then-scan: tile sums, scan of the tile sums one level up, then
+  // each tile scans itself starting from its scanned sum
+  BufferRange sums = partialsRange(partialsOffset, tileCount);
+  dispatch(commandBuffer, Reduce, { input, sums }, { count, 0, 0, 0, 0 }, tileCount);
+  recordScan(commandBuffer, sums, sums, tileCount, partialsOffset + sums.range / sizeof(uint32_t));
+  dispatch(commandBuffer, Scan, { input, sums, output }, { count, 0, 0, 0, 1 }, tileCount);
+}
+
+ComputePrimitives::BufferRange ComputePrimitives::partialsRange(VkDeviceSize elementOffset, uint32_t count) const {
+  // Ranges are padded so the next level starts at an aligned offset
+  VkDeviceSize alignment = std::max<VkDeviceSize>(1, limits.minStorageBufferOffsetAlignment / sizeof(uint32_t));
+  VkDeviceSize paddedCount = (count + alignment - 1) / alignment * alignment;
+  return { partials.buffer, elementOffset * sizeof(uint32_t), paddedCount * sizeof(uint32_t) };
+}
+
+
+uint32_t ComputeReference::Reduce(const std::vector<uint32_t>& values) {
+  uint32_t sum = 0;
+  for (uint32_t value : values)
+  {
+    sum += value;
+  }
+  return sum;
+}
+
+std::vector<uint32_t> ComputeReference::ExclusiveScan(const std::vector<uint32_t>& values) {
+  std::vector<uint32_t> result(values.size());
+  uint32_t sum = 0;
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    result[i] = sum;
+    sum += values[i];
+  }
+  return result;
+}
+
+std::vector<uint32_t> ComputeReference::Compact(const std::vector<uint32_t>& values, const std::vector<uint32_t>& flags) {
+  std::vector<uint32_t> result;
+  for (size_t i = 0; i < values.size(); i++)
+  {
+    if (flags[i] != 0) {
+      result.push_back(values[i]);
+    }
+  }
+  return result;
+}
+
+void ComputeReference::RadixSort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, uint32_t keyBits) {
+  // The GPU sort works in whole digits, so compare the same rounded up bits
+  uint32_t sortedBits = divideRoundUp(std::min(keyBits, 32u), RADIX_BITS) * RADIX_BITS;
+  uint32_t mask = sortedBits >= 32 ? ~0u : (1u << sortedBits) - 1;
+
+  std::vector<uint32_t> order(keys.size());
+  for (uint32_t i = 0; i < order.size(); i++)
+  {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return (keys[a] & mask) < (keys[b] & mask);
+  });
+
+  std::vector<uint32_t> sortedKeys(keys.size());
+  std::vector<uint32_t> sortedValues(values.size());
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    sortedKeys[i] = keys[order[i]];
+    sortedValues[i] = values[order[i]];
+  }
+  keys.swap(sortedKeys);
+  values.swap(sortedValues);
+}
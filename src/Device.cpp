@@ -1,12 +1,23 @@
+#include <string.h>
+#include <stdexcept>
 #include "Device.h"
 #include "Instance.h"
+#include "Window.h"
 
-Device::Device(Instance* instance, VkDevice vkDevice, Queues queues)
-  : instance(instance), vkDevice(vkDevice), queues(queues)
+Device::Device(Instance* instance, const PhysicalDeviceInfo& physicalDevice, VkDevice vkDevice, Queues queues)
+  : instance(instance), physicalDevice(physicalDevice), vkDevice(vkDevice), queues(queues)
 {
+  memoryBudget = new MemoryBudget(this);
+  residencyManager = new ResidencyManager(memoryBudget);
+  syncPool = new SyncPool(this);
+  shaderManager = new ShaderManager(this);
 }
 
 Device::~Device() {
+  delete shaderManager;
+  delete syncPool;
+  delete residencyManager;
+  delete memoryBudget;
   vkDestroyDevice(vkDevice, nullptr);
 }
 
@@ -23,10 +34,206 @@ VkQueue Device::GetQueue(QueueFlags flag) {
 }
 
 unsigned int Device::GetQueueIndex(QueueFlags flag) {
-  return GetInstance()->GetQueueFamilyIndices()[flag];
+  return physicalDevice.queueFamilyIndices[flag];
 }
 
+bool Device::IsExtensionEnabled(const char* extension) const {
+  for (const char* enabled : physicalDevice.extensions)
+  {
+    if (strcmp(enabled, extension) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+SurfaceSupport Device::QuerySurfaceSupport(VkSurfaceKHR surface) const {
+  return ::QuerySurfaceSupport(physicalDevice.physicalDevice, surface);
+}
+
+bool Device::SupportsPresent(VkSurfaceKHR surface) const {
+  int presentFamily = physicalDevice.queueFamilyIndices[QueueFlags::Present];
+  if (presentFamily < 0) {
+    return false;
+  }
+
+  VkBool32 presentSupport = VK_FALSE;
+  vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice.physicalDevice, presentFamily, surface, &presentSupport);
+  return presentSupport == VK_TRUE;
+}
+
+uint32_t Device::FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) {
+  const auto& memoryProperties = physicalDevice.memoryProperties;
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+  {
+    if ((typeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("Failed to find suitable memory type");
+}
+
+VkDeviceMemory Device::AllocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties) {
+  return AllocateMemory(requirements.size, FindMemoryType(requirements.memoryTypeBits, properties));
+}
+
+VkDeviceMemory Device::AllocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex) {
+  VkMemoryAllocateInfo allocateInfo = {};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocateInfo.allocationSize = size;
+  allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(vkDevice, &allocateInfo, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to allocate device memory");
+  }
+
+  memoryBudget->TrackAllocation(memory, allocateInfo.memoryTypeIndex, allocateInfo.allocationSize);
+  return memory;
+}
+
+void Device::FreeMemory(VkDeviceMemory memory) {
+  memoryBudget->TrackFree(memory);
+  vkFreeMemory(vkDevice, memory, nullptr);
+}
+
+void Device::ExecuteOnce(QueueFlags queue, const std::function<void(VkCommandBuffer)>& record) {
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = GetQueueIndex(queue);
+
+  VkCommandPool commandPool;
+  if (vkCreateCommandPool(vkDevice, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create command pool");
+  }
+
+  VkCommandBufferAllocateInfo allocateInfo = {};
+  allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocateInfo.commandPool = commandPool;
+  allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocateInfo.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+  if (vkAllocateCommandBuffers(vkDevice, &allocateInfo, &commandBuffer) != VK_SUCCESS) {
+    vkDestroyCommandPool(vkDevice, commandPool, nullptr);
+    throw std::runtime_error("Failed to allocate command buffer");
+  }
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+  try {
+    record(commandBuffer);
+  } catch (...) {
+    vkDestroyCommandPool(vkDevice, commandPool, nullptr);
+    throw;
+  }
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    vkDestroyCommandPool(vkDevice, commandPool, nullptr);
+    throw std::runtime_error("Failed to record command buffer");
+  }
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+
+  VkFence fence = syncPool->AcquireFence();
+  VkResult result = vkQueueSubmit(GetQueue(queue), 1, &submitInfo, fence);
+  if (result == VK_SUCCESS) {
+    result = vkWaitForFences(vkDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+  }
+
+  // A fence whose wait failed may still be pending, do not hand it out again
+  if (result == VK_SUCCESS) {
+    syncPool->ReleaseFence(fence);
+  }
+  vkDestroyCommandPool(vkDevice, commandPool, nullptr);
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("Failed to execute command buffer");
+  }
+}
+
+MemoryBudget* Device::GetMemoryBudget() {
+  return memoryBudget;
+}
+
+ResidencyManager* Device::GetResidencyManager() {
+  return residencyManager;
+}
+
+SyncPool* Device::GetSyncPool() {
+  return syncPool;
+}
+
+ShaderManager* Device::GetShaderManager() {
+  return shaderManager;
+}
+
+SwapChain* Device::CreateSwapChain(VkSurfaceKHR surface, unsigned int numBuffers, GLFWwindow* window) {
+  return new SwapChain(this, surface, numBuffers, window ? window : GetGLFWWindow());
+}
+
+std::vector<SwapChain*> Device::AcquireSwapChains(const std::vector<SwapChain*>& swapChains) {
+  std::vector<SwapChain*> acquired;
+  for (SwapChain* swapChain : swapChains)
+  {
+    if (swapChain->Acquire() != VK_NOT_READY) {
+      acquired.push_back(swapChain);
+    }
+  }
+  return acquired;
+}
+
+bool Device::PresentSwapChains(const std::vector<SwapChain*>& swapChains) {
+  if (swapChains.empty()) {
+    // Every window is minimized
+    return true;
+  }
+
+  std::vector<VkSemaphore> waitSemaphores(swapChains.size());
+  std::vector<VkSwapchainKHR> vkSwapChains(swapChains.size());
+  std::vector<uint32_t> imageIndices(swapChains.size());
+  std::vector<VkResult> results(swapChains.size(), VK_SUCCESS);
+
+  for (size_t i = 0; i < swapChains.size(); i++)
+  {
+    waitSemaphores[i] = swapChains[i]->GetRenderFinishedVkSemaphore();
+    vkSwapChains[i] = swapChains[i]->GetVkSwapChain();
+    imageIndices[i] = swapChains[i]->GetIndex();
+  }
+
+  VkPresentInfoKHR presentInfo = {};
+  presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  presentInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+  presentInfo.pWaitSemaphores = waitSemaphores.data();
+  presentInfo.swapchainCount = static_cast<uint32_t>(vkSwapChains.size());
+  presentInfo.pSwapchains = vkSwapChains.data();
+  presentInfo.pImageIndices = imageIndices.data();
+  // Per swap chain results, the call's own result only reports the worst of them
+  presentInfo.pResults = results.data();
+
+  VkResult presentResult = vkQueuePresentKHR(GetQueue(QueueFlags::Present), &presentInfo);
+  if (presentResult != VK_SUCCESS && presentResult != VK_SUBOPTIMAL_KHR && presentResult != VK_ERROR_OUT_OF_DATE_KHR) {
+    throw std::runtime_error("Failed to present swap chain images");
+  }
+
+  bool allPresented = true;
+  for (size_t i = 0; i < swapChains.size(); i++)
+  {
+    if (results[i] == VK_ERROR_OUT_OF_DATE_KHR || results[i] == VK_SUBOPTIMAL_KHR) {
+      swapChains[i]->Recreate();
+      allPresented = false;
+    } else if (results[i] != VK_SUCCESS) {
+      throw std::runtime_error("Failed to present swap chain image");
+    }
+  }
 
-SwapChain* Device::CreateSwapChain(VkSurfaceKHR surface, unsigned int numBuffers) {
-  return new SwapChain(this, surface, numBuffers);
+  return allPresented;
 }
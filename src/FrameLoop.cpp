@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <chrono>
+#include "FrameLoop.h"
+#include "Window.h"
+
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  // Simulation steps we are willing to run back to back after a stall before
+  // giving up on real time and dropping the backlog
+  constexpr unsigned int MAX_CATCH_UP_STEPS = 5;
+
+  // Weight of the newest sample in the moving averages
+  constexpr double AVERAGE_WEIGHT = 0.05;
+
+  double millisecondsBetween(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+  }
+} // namespace
+
+
+TripleBuffer::TripleBuffer()
+  : middle(1), writeIndex(0), readIndex(2)
+{
+}
+
+void TripleBuffer::Publish() {
+  unsigned int previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+  writeIndex = previous & INDEX_MASK;
+}
+
+bool TripleBuffer::Acquire() {
+  if (!(middle.load(std::memory_order_acquire) & FRESH_BIT)) {
+    return false;
+  }
+
+  unsigned int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+  readIndex = previous & INDEX_MASK;
+  return true;
+}
+
+
+FrameLoop::FrameLoop(double updateRate)
+  : step(1.0 / updateRate), running(false), idle(false), paused(false), snapshotPublished(false)
+{
+}
+
+FrameLoop::~FrameLoop() {
+  stop();
+}
+
+void FrameLoop::SetIdle(bool idle) {
+  this->idle = idle;
+
+  // Wake the event thread so it notices the change even while in glfwWaitEvents
+  glfwPostEmptyEvent();
+}
+
+void FrameLoop::Run() {
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    running = true;
+    paused = false;
+    snapshotPublished = false;
+  }
+
+  updateThread = std::thread(&FrameLoop::updateLoop, this);
+  renderThread = std::thread(&FrameLoop::renderLoop, this);
+
+  try {
+    while (!ShouldQuit()) {
+      bool shouldPause = idle || IsMinimized();
+      if (shouldPause != paused) {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        paused = shouldPause;
+        stateChanged.notify_all();
+      }
+
+      // Nothing to simulate or draw, sleep until the window system has news.
+      // Otherwise wake at least once per step to keep the pause state current.
+      if (shouldPause) {
+        glfwWaitEvents();
+      } else {
+        glfwWaitEventsTimeout(step);
+      }
+    }
+  } catch (...) {
+    stop();
+    throw;
+  }
+
+  stop();
+}
+
+void FrameLoop::stop() {
+  // Clearing running also releases threads waiting while paused
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    running = false;
+    stateChanged.notify_all();
+  }
+
+  if (updateThread.joinable()) {
+    updateThread.join();
+  }
+  if (renderThread.joinable()) {
+    renderThread.join();
+  }
+}
+
+FrameTimings FrameLoop::GetTimings() const {
+  std::lock_guard<std::mutex> lock(timingMutex);
+  return timings;
+}
+
+bool FrameLoop::waitWhilePaused(std::unique_lock<std::mutex>& lock) {
+  if (!paused) {
+    return false;
+  }
+
+  stateChanged.wait(lock, [this]() { return !running || !paused; });
+  return true;
+}
+
+void FrameLoop::updateLoop() {
+  const auto stepDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(step));
+  auto next = Clock::now();
+
+  while (running) {
+    {
+      std::unique_lock<std::mutex> lock(stateMutex);
+      if (waitWhilePaused(lock)) {
+        // Time spent paused is not simulated
+        next = Clock::now();
+      }
+      stateChanged.wait_until(lock, next, [this]() { return !running || paused; });
+      if (!running) {
+        break;
+      }
+      if (paused) {
+        continue;
+      }
+    }
+
+    auto start = Clock::now();
+    if (start - next > stepDuration * MAX_CATCH_UP_STEPS) {
+      std::lock_guard<std::mutex> lock(timingMutex);
+      timings.droppedUpdates += static_cast<uint64_t>((start - next) / stepDuration);
+      next = start;
+    }
+
+    if (update) {
+      update(step, snapshots.GetWriteIndex());
+    }
+    snapshots.Publish();
+
+    {
+      std::lock_guard<std::mutex> lock(timingMutex);
+      recordTiming(timings.update, millisecondsBetween(start, Clock::now()));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      snapshotPublished = true;
+    }
+    stateChanged.notify_all();
+
+    next += stepDuration;
+  }
+}
+
+void FrameLoop::renderLoop() {
+  bool hasRendered = false;
+  Clock::time_point lastFrame;
+
+  while (running) {
+    {
+      std::unique_lock<std::mutex> lock(stateMutex);
+      if (waitWhilePaused(lock)) {
+        hasRendered = false;
+      }
+      stateChanged.wait(lock, [this]() { return !running || paused || snapshotPublished; });
+      if (!running) {
+        break;
+      }
+      if (paused) {
+        continue;
+      }
+      snapshotPublished = false;
+    }
+
+    if (!snapshots.Acquire()) {
+      continue;
+    }
+
+    auto start = Clock::now();
+    if (render) {
+      render(snapshots.GetReadIndex());
+    }
+    auto end = Clock::now();
+
+    std::lock_guard<std::mutex> lock(timingMutex);
+    recordTiming(timings.render, millisecondsBetween(start, end));
+    if (hasRendered) {
+      recordTiming(timings.frameInterval, millisecondsBetween(lastFrame, start));
+    }
+    hasRendered = true;
+    lastFrame = start;
+  }
+}
+
+void FrameLoop::recordTiming(FrameStageTiming& timing, double milliseconds) {
+  timing.averageMilliseconds = timing.sampleCount == 0
+    ? milliseconds
+    : timing.averageMilliseconds + (milliseconds - timing.averageMilliseconds) * AVERAGE_WEIGHT;
+  timing.sampleCount++;
+  timing.lastMilliseconds = milliseconds;
+  timing.maxMilliseconds = std::max(timing.maxMilliseconds, milliseconds);
+}
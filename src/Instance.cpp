@@ -1,9 +1,13 @@
 #include <string.h>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <stdexcept>
 #include <set>
+#include <string>
 #include <vulkan/vulkan.h>
 #include "Instance.h"
+#include "Window.h"
 
 #ifdef NDEBUG
 const bool ENABLE_VALIDATION_LAYER = false;
@@ -76,15 +80,70 @@ namespace
     "VK_LAYER_KHRONOS_validation"
   };
 
-  bool checkValidationLayerSupport() {
-    // Get all available layers
-    uint32_t layerCount = 0;
-    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+  /**
+   * Device extensions enabled whenever the picked device supports them,
+   * features built on them check Device::IsExtensionEnabled
+   */
+  std::vector<const char*> optionalDeviceExtensions = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+  };
+
+  /**
+   * Layer and extension lists only change when drivers or layers are
+   * installed, so they are enumerated once per process and shared by every
+   * Instance. The loader rescans its manifests on each enumeration, which
+   * is a large part of startup time.
+   */
+  std::mutex enumerationCacheMutex;
+  bool instanceLayersCached = false;
+  std::vector<VkLayerProperties> instanceLayers;
+  std::map<std::string, std::vector<VkExtensionProperties>> deviceExtensionCache;
+
+  const std::vector<VkLayerProperties>& getInstanceLayers() {
+    std::lock_guard<std::mutex> lock(enumerationCacheMutex);
+
+    if (!instanceLayersCached) {
+      uint32_t layerCount = 0;
+      vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+
+      instanceLayers.resize(layerCount);
+      vkEnumerateInstanceLayerProperties(&layerCount, instanceLayers.data());
+      instanceLayers.resize(layerCount);
+      instanceLayersCached = true;
+    }
+
+    return instanceLayers;
+  }
+
+  /**
+   * @brief Extensions of a physical device. Cached by device name and
+   *        pipeline cache UUID rather than handle, handles do not outlive
+   *        their instance but the UUID changes with the driver.
+   */
+  const std::vector<VkExtensionProperties>& getDeviceExtensions(VkPhysicalDevice device, const VkPhysicalDeviceProperties& properties) {
+    std::string key = properties.deviceName;
+    key.append(reinterpret_cast<const char*>(properties.pipelineCacheUUID), VK_UUID_SIZE);
 
-    std::vector<VkLayerProperties> availableLayers(layerCount);
-    vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+    std::lock_guard<std::mutex> lock(enumerationCacheMutex);
+
+    auto it = deviceExtensionCache.find(key);
+    if (it == deviceExtensionCache.end()) {
+      uint32_t extensionCount = 0;
+      vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+      std::vector<VkExtensionProperties> extensions(extensionCount);
+      vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+      extensions.resize(extensionCount);
+
+      it = deviceExtensionCache.emplace(key, std::move(extensions)).first;
+    }
+
+    return it->second;
+  }
+
+  bool checkValidationLayerSupport() {
+    const std::vector<VkLayerProperties>& availableLayers = getInstanceLayers();
 
-    // 
     for (const auto* requiredLayerName : validationLayers)
     {
       bool layerFound = false;
@@ -121,7 +180,12 @@ namespace
     return extensions;
   }
 
+  /**
+   * @brief Find queue families for the required queues. Without a surface,
+   *        present support is asked from GLFW, which only needs the instance.
+   */
   QueueFamilyIndices checkDeviceQueueSupport(
+    VkInstance instance,
     VkPhysicalDevice device,
     QueueFlagBits requiredQueues,
     VkSurfaceKHR surface = VK_NULL_HANDLE
@@ -169,7 +233,11 @@ namespace
 
       if (needsPresent) {
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (surface != VK_NULL_HANDLE) {
+          vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        } else {
+          presentSupport = glfwGetPhysicalDevicePresentationSupport(instance, device, i) == GLFW_TRUE;
+        }
         if (queueFamily.queueCount > 0 && presentSupport) {
           presentSupported = true;
           indices[QueueFlags::Present] = i;
@@ -189,18 +257,12 @@ namespace
   /**
    * @brief Check the physical device for specified extension support
    * 
-   * @param device 
+   * @param availableExtensions 
    * @param requiredExtensions 
    * @return true 
    * @return false 
    */
-  bool checkDeviceExtensionSupport(VkPhysicalDevice device, std::vector<const char*> requiredExtensions) {
-    uint32_t extensionCount;
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-
-    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
-
+  bool checkDeviceExtensionSupport(const std::vector<VkExtensionProperties>& availableExtensions, std::vector<const char*> requiredExtensions) {
     std::set<std::string> requiredExtensionSet(requiredExtensions.begin(), requiredExtensions.end());
 
     for (const auto& extension : availableExtensions)
@@ -210,15 +272,70 @@ namespace
 
     return requiredExtensionSet.empty();
   }
+
+  bool containsExtension(const std::vector<const char*>& extensions, const char* extension) {
+    for (const char* name : extensions)
+    {
+      if (strcmp(name, extension) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Filter extensions down to the ones the physical device supports
+   * 
+   * @param availableExtensions 
+   * @param extensions 
+   * @return std::vector<const char*> 
+   */
+  std::vector<const char*> getSupportedDeviceExtensions(const std::vector<VkExtensionProperties>& availableExtensions, const std::vector<const char*>& extensions) {
+    std::vector<const char*> supported;
+    for (const char* extension : extensions)
+    {
+      if (checkDeviceExtensionSupport(availableExtensions, { extension })) {
+        supported.push_back(extension);
+      }
+    }
+    return supported;
+  }
 } // namespace 
 
+SurfaceSupport QuerySurfaceSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
+  SurfaceSupport support = {};
+
+  // Get basic surface capabilities
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &support.capabilities);
+
+  // Query supported surface formats
+  uint32_t formatCount;
+  vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+
+  if (formatCount != 0) {
+    support.formats.resize(formatCount);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, support.formats.data());
+  }
+
+  // Query supported presentation modes
+  uint32_t presentModeCount;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+
+  if (presentModeCount != 0) {
+    support.presentModes.resize(presentModeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, support.presentModes.data());
+  }
+
+  return support;
+}
+
 
 Instance::Instance(const char* applicationName, unsigned int additionalExtensionCount, const char** additionalExtensions)
 {
   // --- Specify details about our application ---
   VkApplicationInfo appInfo = {};
   appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = VK_API_VERSION_1_1;
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pApplicationName = applicationName;
@@ -285,11 +402,7 @@ Instance::~Instance()
 }
 
 
-void Instance::PickPhysicalDevice(
-  std::vector<const char*> deviceExtensions,
-  QueueFlagBits requiredQueues,
-  VkSurfaceKHR surface
-) {
+std::vector<VkPhysicalDevice> Instance::enumeratePhysicalDevices() const {
   // List the graphics cards on the machine
   uint32_t deviceCount = 0;
   vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
@@ -300,59 +413,136 @@ void Instance::PickPhysicalDevice(
 
   std::vector<VkPhysicalDevice> devices(deviceCount);
   vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+  devices.resize(deviceCount);
+  return devices;
+}
 
-  // Evaluate each GPU and check if it is suitable
-  for (const auto& device : devices) {
-    bool queueSupport = true;
-    queueFamilyIndices = checkDeviceQueueSupport(device, requiredQueues, surface);
-    for (unsigned int i = 0; i < requiredQueues.size(); ++i) {
-      if (requiredQueues[i]) {
-        queueSupport &= (queueFamilyIndices[i] >= 0);
-      }
+bool Instance::checkPhysicalDevice(
+  VkPhysicalDevice device,
+  const std::vector<const char*>& deviceExtensions,
+  QueueFlagBits requiredQueues,
+  VkSurfaceKHR surface,
+  PhysicalDeviceInfo& info
+) const {
+  // Cheapest checks first
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+
+  bool queueSupport = true;
+  QueueFamilyIndices indices = checkDeviceQueueSupport(instance, device, requiredQueues, surface);
+  for (unsigned int i = 0; i < requiredQueues.size(); ++i) {
+    if (requiredQueues[i]) {
+      queueSupport &= (indices[i] >= 0);
     }
+  }
+  if (!queueSupport) {
+    return false;
+  }
 
-    if (requiredQueues[QueueFlags::Present]) {
-      // Get basic surface capabilities
-      vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &surfaceCapabilities);
+  // Extensions are only enumerated here if some are required
+  if (!deviceExtensions.empty() && !checkDeviceExtensionSupport(getDeviceExtensions(device, properties), deviceExtensions)) {
+    return false;
+  }
 
-      // Query supported surface formats
-      uint32_t formatCount;
-      vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+  // Without a surface the formats are checked when the swap chain is created
+  if (requiredQueues[QueueFlags::Present] && surface != VK_NULL_HANDLE) {
+    SurfaceSupport surfaceSupport = QuerySurfaceSupport(device, surface);
+    if (surfaceSupport.formats.empty() || surfaceSupport.presentModes.empty()) {
+      return false;
+    }
+  }
 
-      if (formatCount != 0) {
-        surfaceFormats.resize(formatCount);
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, surfaceFormats.data());
-      }
+  info.physicalDevice = device;
+  info.queueFamilyIndices = indices;
+  info.properties = properties;
+  info.extensions = deviceExtensions;
+  return true;
+}
 
-      // Query supported presentation modes
-      uint32_t presentModeCount;
-      vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+void Instance::completePhysicalDeviceInfo(PhysicalDeviceInfo& info) const {
+  vkGetPhysicalDeviceMemoryProperties(info.physicalDevice, &info.memoryProperties);
 
-      if (presentModeCount != 0) {
-        presentModes.resize(presentModeCount);
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, presentModes.data());
+  // Optional extensions query through vkGetPhysicalDeviceProperties2 and friends, which need 1.1
+  if (info.properties.apiVersion >= VK_API_VERSION_1_1) {
+    const std::vector<VkExtensionProperties>& availableExtensions = getDeviceExtensions(info.physicalDevice, info.properties);
+    for (const char* extension : getSupportedDeviceExtensions(availableExtensions, optionalDeviceExtensions))
+    {
+      if (!containsExtension(info.extensions, extension)) {
+        info.extensions.push_back(extension);
       }
     }
+  }
+}
 
-    if (queueSupport &&
-      checkDeviceExtensionSupport(device, deviceExtensions) &&
-      (!requiredQueues[QueueFlags::Present] || (!surfaceFormats.empty() && ! presentModes.empty()))
-    ) {
-      physicalDevice = device;
-      break;
+void Instance::PickPhysicalDevice(
+  std::vector<const char*> deviceExtensions,
+  QueueFlagBits requiredQueues,
+  VkSurfaceKHR surface
+) {
+  // Evaluate each GPU and take the first suitable one
+  for (VkPhysicalDevice device : enumeratePhysicalDevices()) {
+    if (checkPhysicalDevice(device, deviceExtensions, requiredQueues, surface, pickedDevice)) {
+      return;
     }
   }
 
-  this->deviceExtensions = deviceExtensions;
+  throw std::runtime_error("Failed to find a suitable GPU");
+}
+
+Device* Instance::CreateDevice(QueueFlagBits requiredQueues, VkPhysicalDeviceFeatures deviceFeatures) {
+  if (pickedDevice.physicalDevice == VK_NULL_HANDLE) {
+    throw std::runtime_error("No physical device picked");
+  }
+
+  return createDevice(pickedDevice, requiredQueues, deviceFeatures);
+}
 
-  if (physicalDevice == VK_NULL_HANDLE) {
+std::vector<Device*> Instance::CreateDevices(
+  std::vector<const char*> deviceExtensions,
+  QueueFlagBits requiredQueues,
+  VkPhysicalDeviceFeatures deviceFeatures,
+  unsigned int devicesPerPhysicalDevice
+) {
+  if (requiredQueues[QueueFlags::Present]) {
+    throw std::runtime_error("CreateDevices is headless, create presenting devices with CreateDevice");
+  }
+
+  std::vector<PhysicalDeviceInfo> suitable;
+  for (VkPhysicalDevice device : enumeratePhysicalDevices()) {
+    PhysicalDeviceInfo info;
+    if (checkPhysicalDevice(device, deviceExtensions, requiredQueues, VK_NULL_HANDLE, info)) {
+      suitable.push_back(info);
+    }
+  }
+
+  if (suitable.empty()) {
     throw std::runtime_error("Failed to find a suitable GPU");
   }
 
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
+  std::vector<Device*> devices;
+  try {
+    for (const PhysicalDeviceInfo& info : suitable)
+    {
+      for (unsigned int i = 0; i < devicesPerPhysicalDevice; i++)
+      {
+        devices.push_back(createDevice(info, requiredQueues, deviceFeatures));
+      }
+    }
+  } catch (...) {
+    for (Device* device : devices)
+    {
+      delete device;
+    }
+    throw;
+  }
+
+  return devices;
 }
 
-Device* Instance::CreateDevice(QueueFlagBits requiredQueues, VkPhysicalDeviceFeatures deviceFeatures) {
+Device* Instance::createDevice(PhysicalDeviceInfo info, QueueFlagBits requiredQueues, VkPhysicalDeviceFeatures deviceFeatures) {
+  completePhysicalDeviceInfo(info);
+  const QueueFamilyIndices& queueFamilyIndices = info.queueFamilyIndices;
+
   std::set<int> uniqueQueueFamilies;
   bool queueSupport = true;
   for (unsigned int i = 0; i < requiredQueues.size(); i++)
@@ -389,8 +579,8 @@ Device* Instance::CreateDevice(QueueFlagBits requiredQueues, VkPhysicalDeviceFea
   deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
   // Enable device-specific extensions and validation layers
-  deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(info.extensions.size());
+  deviceCreateInfo.ppEnabledExtensionNames = info.extensions.data();
 
   if (ENABLE_VALIDATION_LAYER) {
     deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -400,11 +590,12 @@ Device* Instance::CreateDevice(QueueFlagBits requiredQueues, VkPhysicalDeviceFea
   }
 
   VkDevice vkDevice;
-  if (vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &vkDevice) != VK_SUCCESS) {
+  if (vkCreateDevice(info.physicalDevice, &deviceCreateInfo, nullptr, &vkDevice) != VK_SUCCESS) {
     throw std::runtime_error("Failed to create logical device");
   }
 
   Device::Queues queues;
+  queues.fill(VK_NULL_HANDLE);
   for (unsigned int i = 0; i < requiredQueues.size(); i++)
   {
     if (requiredQueues[i]) {
@@ -412,5 +603,5 @@ Device* Instance::CreateDevice(QueueFlagBits requiredQueues, VkPhysicalDeviceFea
     }
   }
 
-  return new Device(this, vkDevice, queues);
+  return new Device(this, info, vkDevice, queues);
 }
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include "MemoryBudget.h"
+#include "Device.h"
+#include "Instance.h"
+
+namespace
+{
+  // Without driver numbers, budget this share of each heap. Leaves room for
+  // other processes and driver internal allocations.
+  constexpr VkDeviceSize FALLBACK_BUDGET_NUMERATOR = 8;
+  constexpr VkDeviceSize FALLBACK_BUDGET_DENOMINATOR = 10;
+} // namespace
+
+
+MemoryBudget::MemoryBudget(Device* device)
+  : device(device)
+{
+  driverReported = device->IsExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  const auto& memoryProperties = device->GetMemoryProperties();
+  heaps.resize(memoryProperties.memoryHeapCount);
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+  {
+    const VkMemoryHeap& heap = memoryProperties.memoryHeaps[i];
+    heaps[i].size = heap.size;
+    heaps[i].budget = heap.size / FALLBACK_BUDGET_DENOMINATOR * FALLBACK_BUDGET_NUMERATOR;
+    heaps[i].usage = 0;
+    heaps[i].allocated = 0;
+    heaps[i].deviceLocal = (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+  }
+
+  Update();
+}
+
+void MemoryBudget::Update() {
+  if (!driverReported) {
+    return;
+  }
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+  budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+  VkPhysicalDeviceMemoryProperties2 memoryProperties = {};
+  memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  memoryProperties.pNext = &budgetProperties;
+
+  vkGetPhysicalDeviceMemoryProperties2(device->GetPhysicalDevice(), &memoryProperties);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (size_t i = 0; i < heaps.size(); i++)
+  {
+    heaps[i].budget = budgetProperties.heapBudget[i];
+    heaps[i].usage = budgetProperties.heapUsage[i];
+  }
+}
+
+std::vector<HeapBudget> MemoryBudget::GetHeapBudgets() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return heaps;
+}
+
+HeapBudget MemoryBudget::GetHeapBudget(uint32_t heapIndex) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return heaps.at(heapIndex);
+}
+
+uint32_t MemoryBudget::GetHeapIndex(uint32_t memoryTypeIndex) const {
+  return device->GetMemoryProperties().memoryTypes[memoryTypeIndex].heapIndex;
+}
+
+void MemoryBudget::TrackAllocation(VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize size) {
+  uint32_t heapIndex = GetHeapIndex(memoryTypeIndex);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  allocations[memory] = { heapIndex, size };
+
+  HeapBudget& heap = heaps[heapIndex];
+  heap.allocated += size;
+  if (driverReported) {
+    // Driver usage is a snapshot, extrapolate until the next Update()
+    heap.usage += size;
+  } else {
+    heap.usage = heap.allocated;
+  }
+}
+
+void MemoryBudget::TrackFree(VkDeviceMemory memory) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = allocations.find(memory);
+  if (it == allocations.end()) {
+    return;
+  }
+
+  HeapBudget& heap = heaps[it->second.heapIndex];
+  heap.allocated -= it->second.size;
+  if (driverReported) {
+    heap.usage -= std::min(heap.usage, it->second.size);
+  } else {
+    heap.usage = heap.allocated;
+  }
+
+  allocations.erase(it);
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "RadixSort.h"
+
+namespace
+{
+  constexpr unsigned int DIGIT_BITS = 8;
+  constexpr unsigned int DIGIT_COUNT = 1 << DIGIT_BITS;
+  constexpr unsigned int PASS_COUNT = 64 / DIGIT_BITS;
+
+  // Below this many keys the thread start-up cost outweighs the parallel speed-up
+  constexpr size_t PARALLEL_THRESHOLD = 1 << 16;
+
+  using Histogram = std::array<size_t, DIGIT_COUNT>;
+
+  /**
+   * @brief Reusable barrier, std::barrier is not available in C++11
+   */
+  class Barrier
+  {
+  public:
+    explicit Barrier(unsigned int count) : count(count), waiting(0), generation(0) {}
+
+    void Wait() {
+      std::unique_lock<std::mutex> lock(mutex);
+      unsigned int arrivedGeneration = generation;
+      if (++waiting == count) {
+        waiting = 0;
+        generation++;
+        condition.notify_all();
+      } else {
+        condition.wait(lock, [&]() { return arrivedGeneration != generation; });
+      }
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    unsigned int count;
+    unsigned int waiting;
+    unsigned int generation;
+  };
+
+  struct SortState
+  {
+    size_t count;
+    unsigned int threadCount;
+    uint64_t* keys[2];
+    uint32_t* values[2];
+    std::vector<Histogram> histograms;
+    std::vector<uint64_t> differingBits;
+    unsigned int resultBuffer;
+    Barrier barrier;
+
+    SortState(size_t count, unsigned int threadCount)
+      : count(count), threadCount(threadCount),
+        histograms(threadCount), differingBits(threadCount, 0),
+        resultBuffer(0), barrier(threadCount) {}
+  };
+
+  /**
+   * @brief Body run by each sorting thread on its contiguous chunk. Every
+   *        thread walks the same pass sequence, so buffer ping-ponging stays
+   *        in lock step without extra coordination.
+   *
+   * @param state
+   * @param thread
+   */
+  void sortChunk(SortState& state, unsigned int thread) {
+    const size_t begin = state.count * thread / state.threadCount;
+    const size_t end = state.count * (thread + 1) / state.threadCount;
+
+    // Find which bits vary at all, digits made only of constant bits need no pass
+    uint64_t first = state.keys[0][0];
+    uint64_t differing = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+      differing |= state.keys[0][i] ^ first;
+    }
+    state.differingBits[thread] = differing;
+    state.barrier.Wait();
+
+    differing = 0;
+    for (uint64_t bits : state.differingBits)
+    {
+      differing |= bits;
+    }
+
+    unsigned int source = 0;
+    for (unsigned int pass = 0; pass < PASS_COUNT; pass++)
+    {
+      const unsigned int shift = pass * DIGIT_BITS;
+      if (((differing >> shift) & (DIGIT_COUNT - 1)) == 0) {
+        continue;
+      }
+
+      const uint64_t* srcKeys = state.keys[source];
+      const uint32_t* srcValues = state.values[source];
+      uint64_t* dstKeys = state.keys[source ^ 1];
+      uint32_t* dstValues = state.values[source ^ 1];
+
+      Histogram& histogram = state.histograms[thread];
+      histogram.fill(0);
+      for (size_t i = begin; i < end; i++)
+      {
+        histogram[(srcKeys[i] >> shift) & (DIGIT_COUNT - 1)]++;
+      }
+      state.barrier.Wait();
+
+      // Digit-major, thread-minor exclusive scan keeps the sort stable
+      Histogram offsets;
+      size_t running = 0;
+      for (unsigned int digit = 0; digit < DIGIT_COUNT; digit++)
+      {
+        for (unsigned int t = 0; t < state.threadCount; t++)
+        {
+          if (t == thread) {
+            offsets[digit] = running;
+          }
+          running += state.histograms[t][digit];
+        }
+      }
+
+      for (size_t i = begin; i < end; i++)
+      {
+        size_t destination = offsets[(srcKeys[i] >> shift) & (DIGIT_COUNT - 1)]++;
+        dstKeys[destination] = srcKeys[i];
+        dstValues[destination] = srcValues[i];
+      }
+      state.barrier.Wait();
+
+      source ^= 1;
+    }
+
+    if (thread == 0) {
+      state.resultBuffer = source;
+    }
+  }
+} // namespace
+
+
+void RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, unsigned int threadCount) {
+  if (keys.size() != values.size()) {
+    throw std::runtime_error("Radix sort keys and values differ in length");
+  }
+  if (keys.size() < 2) {
+    return;
+  }
+
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (keys.size() < PARALLEL_THRESHOLD) {
+    threadCount = 1;
+  }
+
+  std::vector<uint64_t> scratchKeys(keys.size());
+  std::vector<uint32_t> scratchValues(values.size());
+
+  SortState state(keys.size(), threadCount);
+  state.keys[0] = keys.data();
+  state.keys[1] = scratchKeys.data();
+  state.values[0] = values.data();
+  state.values[1] = scratchValues.data();
+
+  std::vector<std::thread> workers;
+  for (unsigned int t = 1; t < threadCount; t++)
+  {
+    workers.emplace_back(sortChunk, std::ref(state), t);
+  }
+  sortChunk(state, 0);
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  // An odd number of executed passes leaves the result in the scratch buffers
+  if (state.resultBuffer == 1) {
+    keys.swap(scratchKeys);
+    values.swap(scratchValues);
+  }
+}
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "RenderQueue.h"
+#include "RadixSort.h"
+
+namespace
+{
+  constexpr uint32_t UNBOUND = ~0u;
+
+  enum StateChangeBits {
+    PipelineChanged = 1 << 0,
+    DescriptorSetChanged = 1 << 1,
+    MaterialChanged = 1 << 2,
+    MeshChanged = 1 << 3,
+  };
+
+  struct BoundState
+  {
+    uint32_t pipeline = UNBOUND;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    uint32_t descriptorSet = UNBOUND;
+    uint32_t material = UNBOUND;
+    uint32_t mesh = UNBOUND;
+  };
+
+  /**
+   * @brief Work out which binds a batch needs on top of the currently bound
+   *        state and update it. A pipeline with a different layout disturbs
+   *        the bound descriptor sets, so they are rebound as well.
+   *
+   * @param bound
+   * @param batch
+   * @param layout Layout of the batch's pipeline
+   * @return unsigned int Combination of StateChangeBits
+   */
+  unsigned int trackState(BoundState& bound, const DrawBatch& batch, VkPipelineLayout layout) {
+    unsigned int changes = 0;
+
+    if (batch.pipeline != bound.pipeline) {
+      changes |= PipelineChanged;
+      if (layout != bound.layout) {
+        bound.descriptorSet = UNBOUND;
+        bound.material = UNBOUND;
+      }
+      bound.pipeline = batch.pipeline;
+      bound.layout = layout;
+    }
+    if (batch.descriptorSet != bound.descriptorSet) {
+      changes |= DescriptorSetChanged;
+      bound.descriptorSet = batch.descriptorSet;
+    }
+    if (batch.material != bound.material) {
+      changes |= MaterialChanged;
+      bound.material = batch.material;
+    }
+    if (batch.mesh != bound.mesh) {
+      changes |= MeshChanged;
+      bound.mesh = batch.mesh;
+    }
+
+    return changes;
+  }
+
+  void countChanges(RenderQueueStats& stats, unsigned int changes) {
+    stats.drawCalls++;
+    stats.pipelineBinds += (changes & PipelineChanged) ? 1 : 0;
+    stats.descriptorSetBinds += (changes & DescriptorSetChanged) ? 1 : 0;
+    stats.descriptorSetBinds += (changes & MaterialChanged) ? 1 : 0;
+    stats.meshBinds += (changes & MeshChanged) ? 1 : 0;
+  }
+
+  template <typename T>
+  uint32_t registerEntry(std::vector<T>& entries, const T& entry, unsigned int bits, const char* what) {
+    if (entries.size() >= (size_t(1) << bits)) {
+      throw std::runtime_error(std::string("Too many render queue ") + what + " registrations");
+    }
+    entries.push_back(entry);
+    return static_cast<uint32_t>(entries.size() - 1);
+  }
+
+  /**
+   * @brief Check an id came from the matching Register* function. The tables
+   *        never outgrow their key field, so a registered id also fits it and
+   *        cannot alias another id in the sort key.
+   */
+  template <typename T>
+  void checkId(const std::vector<T>& entries, uint32_t id, unsigned int bits, const char* what) {
+    if (id >= entries.size() || id >= (uint64_t(1) << bits)) {
+      throw std::runtime_error(std::string("Render queue draw uses an unregistered ") + what + " id");
+    }
+  }
+} // namespace
+
+
+uint64_t RenderQueue::MakeSortKey(uint32_t pipeline, uint32_t descriptorSet, uint32_t material, uint32_t mesh, float depth) {
+  const uint64_t depthMax = (1ull << DEPTH_BITS) - 1;
+  float clampedDepth = std::min(std::max(depth, 0.0f), 1.0f);
+  uint64_t quantizedDepth = static_cast<uint64_t>(clampedDepth * static_cast<float>(depthMax));
+
+  uint64_t key = pipeline & ((1ull << PIPELINE_BITS) - 1);
+  key = (key << DESCRIPTOR_SET_BITS) | (descriptorSet & ((1ull << DESCRIPTOR_SET_BITS) - 1));
+  key = (key << MATERIAL_BITS) | (material & ((1ull << MATERIAL_BITS) - 1));
+  key = (key << MESH_BITS) | (mesh & ((1ull << MESH_BITS) - 1));
+  key = (key << DEPTH_BITS) | quantizedDepth;
+  return key;
+}
+
+RenderQueue::RenderQueue(unsigned int sortThreadCount)
+  : sortThreadCount(sortThreadCount)
+{
+}
+
+uint32_t RenderQueue::RegisterPipeline(VkPipeline pipeline, VkPipelineLayout layout) {
+  return registerEntry(pipelines, PipelineEntry{ pipeline, layout }, PIPELINE_BITS, "pipeline");
+}
+
+uint32_t RenderQueue::RegisterDescriptorSet(VkDescriptorSet descriptorSet) {
+  return registerEntry(descriptorSets, descriptorSet, DESCRIPTOR_SET_BITS, "descriptor set");
+}
+
+uint32_t RenderQueue::RegisterMaterial(VkDescriptorSet materialSet) {
+  return registerEntry(materials, materialSet, MATERIAL_BITS, "material");
+}
+
+uint32_t RenderQueue::RegisterMesh(VkBuffer vertexBuffer, VkBuffer indexBuffer, uint32_t indexCount, VkIndexType indexType) {
+  return registerEntry(meshes, MeshEntry{ vertexBuffer, indexBuffer, indexCount, indexType }, MESH_BITS, "mesh");
+}
+
+void RenderQueue::Submit(const DrawItem& item) {
+  checkId(pipelines, item.pipeline, PIPELINE_BITS, "pipeline");
+  checkId(descriptorSets, item.descriptorSet, DESCRIPTOR_SET_BITS, "descriptor set");
+  checkId(materials, item.material, MATERIAL_BITS, "material");
+  checkId(meshes, item.mesh, MESH_BITS, "mesh");
+  items.push_back(item);
+}
+
+void RenderQueue::Clear() {
+  items.clear();
+  batches.clear();
+  instanceIndices.clear();
+}
+
+void RenderQueue::Sort() {
+  // --- Build and sort keys ---
+  sortKeys.resize(items.size());
+  sortedItems.resize(items.size());
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    const DrawItem& item = items[i];
+    sortKeys[i] = MakeSortKey(item.pipeline, item.descriptorSet, item.material, item.mesh, item.depth);
+    sortedItems[i] = static_cast<uint32_t>(i);
+  }
+
+  RadixSort(sortKeys, sortedItems, sortThreadCount);
+
+  // --- Merge equal state into instanced batches ---
+  batches.clear();
+  instanceIndices.resize(items.size());
+
+  const uint64_t stateMask = ~((1ull << DEPTH_BITS) - 1);
+  for (size_t i = 0; i < sortedItems.size(); i++)
+  {
+    const DrawItem& item = items[sortedItems[i]];
+    instanceIndices[i] = item.instanceIndex;
+
+    if (i > 0 && (sortKeys[i] & stateMask) == (sortKeys[i - 1] & stateMask)) {
+      batches.back().instanceCount++;
+    } else {
+      batches.push_back({ item.pipeline, item.descriptorSet, item.material, item.mesh, static_cast<uint32_t>(i), 1 });
+    }
+  }
+}
+
+void RenderQueue::Record(VkCommandBuffer commandBuffer) const {
+  BoundState bound;
+
+  for (const auto& batch : batches)
+  {
+    const PipelineEntry& pipeline = pipelines[batch.pipeline];
+    unsigned int changes = trackState(bound, batch, pipeline.layout);
+
+    if (changes & PipelineChanged) {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+    }
+    if (changes & DescriptorSetChanged) {
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout,
+        0, 1, &descriptorSets[batch.descriptorSet], 0, nullptr);
+    }
+    if (changes & MaterialChanged) {
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.layout,
+        1, 1, &materials[batch.material], 0, nullptr);
+    }
+
+    const MeshEntry& mesh = meshes[batch.mesh];
+    if (changes & MeshChanged) {
+      VkDeviceSize offset = 0;
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &offset);
+      vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, mesh.indexType);
+    }
+
+    vkCmdDrawIndexed(commandBuffer, mesh.indexCount, batch.instanceCount, 0, 0, batch.firstInstance);
+  }
+}
+
+RenderQueueStats RenderQueue::GetStats() const {
+  RenderQueueStats stats;
+  stats.draws = items.size();
+
+  BoundState bound;
+  for (const auto& batch : batches)
+  {
+    countChanges(stats, trackState(bound, batch, pipelines[batch.pipeline].layout));
+  }
+
+  return stats;
+}
+
+RenderQueueStats RenderQueue::GetUnsortedStats() const {
+  RenderQueueStats stats;
+  stats.draws = items.size();
+
+  BoundState bound;
+  for (size_t i = 0; i < items.size(); i++)
+  {
+    const DrawItem& item = items[i];
+    DrawBatch batch = { item.pipeline, item.descriptorSet, item.material, item.mesh, static_cast<uint32_t>(i), 1 };
+    countChanges(stats, trackState(bound, batch, pipelines[item.pipeline].layout));
+  }
+
+  return stats;
+}
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "ResidencyManager.h"
+
+ResidencyManager::ResidencyManager(MemoryBudget* budget, float highWaterMark, float lowWaterMark, unsigned int framesInFlight)
+  : budget(budget), highWaterMark(highWaterMark), lowWaterMark(lowWaterMark), framesInFlight(framesInFlight),
+    frame(0), nextId(0)
+{
+  if (lowWaterMark > highWaterMark) {
+    throw std::runtime_error("Residency low water mark is above the high water mark");
+  }
+
+  lruLists.resize(budget->GetHeapBudgets().size());
+  heapLimits.resize(lruLists.size(), std::numeric_limits<VkDeviceSize>::max());
+}
+
+ResidencyManager::ResourceId ResidencyManager::Register(uint32_t heapIndex, VkDeviceSize residentSize, EvictFunction evict) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  ResourceId id = nextId++;
+  Resource& resource = resources[id];
+  resource.heapIndex = heapIndex;
+  resource.residentSize = residentSize;
+  resource.lastUsedFrame = frame;
+  resource.evict = evict;
+
+  auto& lru = lruLists.at(heapIndex);
+  resource.lruPosition = residentSize > 0 ? lru.insert(lru.end(), id) : lru.end();
+
+  return id;
+}
+
+void ResidencyManager::Unregister(ResourceId id) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = resources.find(id);
+  if (it == resources.end()) {
+    return;
+  }
+
+  if (it->second.residentSize > 0) {
+    lruLists[it->second.heapIndex].erase(it->second.lruPosition);
+  }
+  resources.erase(it);
+}
+
+void ResidencyManager::Touch(ResourceId id) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  Resource& resource = resources.at(id);
+  resource.lastUsedFrame = frame;
+  if (resource.residentSize > 0) {
+    auto& lru = lruLists[resource.heapIndex];
+    lru.splice(lru.end(), lru, resource.lruPosition);
+  }
+}
+
+void ResidencyManager::SetResidentSize(ResourceId id, VkDeviceSize residentSize) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  Resource& resource = resources.at(id);
+  auto& lru = lruLists[resource.heapIndex];
+  if (resource.residentSize == 0 && residentSize > 0) {
+    // Coming back in means it is about to be used, and the LRU list must stay ordered by last use
+    resource.lastUsedFrame = frame;
+    resource.lruPosition = lru.insert(lru.end(), id);
+  } else if (resource.residentSize > 0 && residentSize == 0) {
+    lru.erase(resource.lruPosition);
+  }
+  resource.residentSize = residentSize;
+}
+
+void ResidencyManager::SetHeapLimit(uint32_t heapIndex, VkDeviceSize limit) {
+  std::lock_guard<std::mutex> lock(mutex);
+  heapLimits.at(heapIndex) = limit;
+}
+
+void ResidencyManager::NextFrame() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    frame++;
+  }
+
+  budget->Update();
+  Enforce();
+}
+
+VkDeviceSize ResidencyManager::Enforce() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  VkDeviceSize evicted = 0;
+  for (uint32_t i = 0; i < lruLists.size(); i++)
+  {
+    HeapBudget heap = budget->GetHeapBudget(i);
+    VkDeviceSize heapBudget = std::min(heap.budget, heapLimits[i]);
+    VkDeviceSize highWater = static_cast<VkDeviceSize>(heapBudget * highWaterMark);
+    VkDeviceSize lowWater = static_cast<VkDeviceSize>(heapBudget * lowWaterMark);
+    if (heap.usage > highWater) {
+      evicted += evictFromHeap(i, heap.usage - lowWater);
+    }
+  }
+
+  return evicted;
+}
+
+ResidencyStats ResidencyManager::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  ResidencyStats current = stats;
+  for (const auto& entry : resources)
+  {
+    if (entry.second.residentSize > 0) {
+      current.residentResources++;
+    } else {
+      current.nonResidentResources++;
+    }
+  }
+  return current;
+}
+
+VkDeviceSize ResidencyManager::evictFromHeap(uint32_t heapIndex, VkDeviceSize target) {
+  auto& lru = lruLists[heapIndex];
+
+  VkDeviceSize evicted = 0;
+  auto it = lru.begin();
+  while (it != lru.end() && evicted < target) {
+    Resource& resource = resources[*it];
+
+    // The list is ordered by last use, everything from here on may still be in flight
+    if (resource.lastUsedFrame + framesInFlight > frame) {
+      break;
+    }
+
+    VkDeviceSize previousSize = resource.residentSize;
+    VkDeviceSize newSize = resource.evict(previousSize);
+    if (newSize >= previousSize) {
+      ++it;
+      continue;
+    }
+
+    evicted += previousSize - newSize;
+    stats.evictions++;
+    stats.evictedBytes += previousSize - newSize;
+    resource.residentSize = newSize;
+
+    if (newSize == 0) {
+      it = lru.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  return evicted;
+}
@@ -0,0 +1,203 @@
+#include <cstring>
+#include <stdexcept>
+#include "ResidentBuffer.h"
+#include "Device.h"
+
+namespace
+{
+  constexpr uint32_t NO_HEAP = ~0u;
+
+  /**
+   * @brief Find a memory type with the properties outside excludedHeap
+   *
+   * @return true A memory type was found and written to typeIndex
+   */
+  bool findMemoryType(Device* device, uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t excludedHeap, uint32_t& typeIndex) {
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = device->GetMemoryProperties();
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    {
+      const VkMemoryType& type = memoryProperties.memoryTypes[i];
+      if ((typeBits & (1 << i)) && (type.propertyFlags & properties) == properties && type.heapIndex != excludedHeap) {
+        typeIndex = i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Queue to copy on, the dedicated transfer queue if the device has one
+   */
+  QueueFlags copyQueue(Device* device) {
+    for (QueueFlags flag : { QueueFlags::Transfer, QueueFlags::Compute, QueueFlags::Graphics })
+    {
+      if (device->GetQueue(flag) != VK_NULL_HANDLE) {
+        return flag;
+      }
+    }
+    throw std::runtime_error("Device has no queue to copy buffers on");
+  }
+} // namespace
+
+
+ResidentBuffer::ResidentBuffer(Device* device, VkDeviceSize size, VkBufferUsageFlags usage)
+  : device(device), size(size), usage(usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT),
+    deviceLocal(true)
+{
+  buffer = createBuffer(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, NO_HEAP, memory, deviceLocalHeap);
+  if (buffer == VK_NULL_HANDLE) {
+    throw std::runtime_error("Failed to find device local memory for buffer");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device->GetVkDevice(), buffer, &requirements);
+  residencyId = device->GetResidencyManager()->Register(deviceLocalHeap, requirements.size,
+    [this](VkDeviceSize residentSize) { return demote(residentSize); });
+}
+
+ResidentBuffer::~ResidentBuffer() {
+  device->GetResidencyManager()->Unregister(residencyId);
+  vkDestroyBuffer(device->GetVkDevice(), buffer, nullptr);
+  device->FreeMemory(memory);
+}
+
+void ResidentBuffer::Touch() {
+  device->GetResidencyManager()->Touch(residencyId);
+}
+
+void ResidentBuffer::Upload(const void* data, VkDeviceSize size) {
+  transfer(data, nullptr, size);
+}
+
+void ResidentBuffer::Download(void* data, VkDeviceSize size) {
+  transfer(nullptr, data, size);
+}
+
+VkDeviceSize ResidentBuffer::demote(VkDeviceSize residentSize) {
+  // Host memory only helps if it comes out of a different heap, on unified
+  // memory devices there is nothing to gain
+  VkDeviceMemory hostMemory;
+  uint32_t hostHeap;
+  VkBuffer hostBuffer = createBuffer(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    deviceLocalHeap, hostMemory, hostHeap);
+  if (hostBuffer == VK_NULL_HANDLE) {
+    return residentSize;
+  }
+
+  try {
+    copyBuffer(buffer, hostBuffer, size);
+  } catch (...) {
+    vkDestroyBuffer(device->GetVkDevice(), hostBuffer, nullptr);
+    device->FreeMemory(hostMemory);
+    throw;
+  }
+
+  vkDestroyBuffer(device->GetVkDevice(), buffer, nullptr);
+  device->FreeMemory(memory);
+  buffer = hostBuffer;
+  memory = hostMemory;
+  deviceLocal = false;
+  return 0;
+}
+
+void ResidentBuffer::transfer(const void* uploadData, void* downloadData, VkDeviceSize size) {
+  VkDevice vkDevice = device->GetVkDevice();
+  bool upload = uploadData != nullptr;
+  if (size > this->size) {
+    throw std::runtime_error("Transfer is larger than the buffer");
+  }
+
+  // Host visible memory is mapped directly, device local memory goes through a staging buffer
+  VkBuffer staging = VK_NULL_HANDLE;
+  VkDeviceMemory mappedMemory = memory;
+  if (deviceLocal) {
+    uint32_t stagingHeap;
+    staging = createBuffer(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, NO_HEAP, mappedMemory, stagingHeap);
+    if (staging == VK_NULL_HANDLE) {
+      throw std::runtime_error("Failed to find host visible memory for staging buffer");
+    }
+  }
+
+  try {
+    if (staging != VK_NULL_HANDLE && !upload) {
+      copyBuffer(buffer, staging, size);
+    }
+
+    void* mapped;
+    if (vkMapMemory(vkDevice, mappedMemory, 0, size, 0, &mapped) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to map buffer memory");
+    }
+    if (upload) {
+      std::memcpy(mapped, uploadData, static_cast<size_t>(size));
+    } else {
+      std::memcpy(downloadData, mapped, static_cast<size_t>(size));
+    }
+    vkUnmapMemory(vkDevice, mappedMemory);
+
+    if (staging != VK_NULL_HANDLE && upload) {
+      copyBuffer(staging, buffer, size);
+    }
+  } catch (...) {
+    if (staging != VK_NULL_HANDLE) {
+      vkDestroyBuffer(vkDevice, staging, nullptr);
+      device->FreeMemory(mappedMemory);
+    }
+    throw;
+  }
+
+  if (staging != VK_NULL_HANDLE) {
+    vkDestroyBuffer(vkDevice, staging, nullptr);
+    device->FreeMemory(mappedMemory);
+  }
+}
+
+VkBuffer ResidentBuffer::createBuffer(VkMemoryPropertyFlags properties, uint32_t excludedHeap, VkDeviceMemory& memory, uint32_t& heapIndex) {
+  VkDevice vkDevice = device->GetVkDevice();
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer newBuffer;
+  if (vkCreateBuffer(vkDevice, &bufferInfo, nullptr, &newBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create buffer");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(vkDevice, newBuffer, &requirements);
+
+  uint32_t typeIndex;
+  if (!findMemoryType(device, requirements.memoryTypeBits, properties, excludedHeap, typeIndex)) {
+    vkDestroyBuffer(vkDevice, newBuffer, nullptr);
+    return VK_NULL_HANDLE;
+  }
+
+  try {
+    memory = device->AllocateMemory(requirements.size, typeIndex);
+  } catch (...) {
+    vkDestroyBuffer(vkDevice, newBuffer, nullptr);
+    throw;
+  }
+  vkBindBufferMemory(vkDevice, newBuffer, memory, 0);
+
+  heapIndex = device->GetMemoryProperties().memoryTypes[typeIndex].heapIndex;
+  return newBuffer;
+}
+
+void ResidentBuffer::copyBuffer(VkBuffer source, VkBuffer destination, VkDeviceSize size) {
+  device->ExecuteOnce(copyQueue(device), [&](VkCommandBuffer commandBuffer) {
+    VkBufferCopy region = {};
+    region.size = size;
+    vkCmdCopyBuffer(commandBuffer, source, destination, 1, &region);
+
+    // Make the copy visible to mapped host reads
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+  });
+}
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "ResidentImage.h"
+#include "Device.h"
+
+namespace
+{
+  VkDeviceSize formatTexelSize(VkFormat format) {
+    switch (format) {
+      case VK_FORMAT_R8_UNORM:
+        return 1;
+      case VK_FORMAT_R8G8_UNORM:
+        return 2;
+      case VK_FORMAT_R8G8B8A8_UNORM:
+      case VK_FORMAT_R8G8B8A8_SRGB:
+      case VK_FORMAT_B8G8R8A8_UNORM:
+      case VK_FORMAT_B8G8R8A8_SRGB:
+      case VK_FORMAT_R32_SFLOAT:
+        return 4;
+      case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return 8;
+      case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+      default:
+        throw std::runtime_error("Unsupported ResidentImage format");
+    }
+  }
+
+  /**
+   * @brief Queue to copy on. Images are exclusive to one queue family, so the
+   *        copies go to the family that samples them rather than a dedicated
+   *        transfer queue.
+   */
+  QueueFlags imageQueue(Device* device) {
+    for (QueueFlags flag : { QueueFlags::Graphics, QueueFlags::Compute, QueueFlags::Transfer })
+    {
+      if (device->GetQueue(flag) != VK_NULL_HANDLE) {
+        return flag;
+      }
+    }
+    throw std::runtime_error("Device has no queue to copy images on");
+  }
+
+  VkImageSubresourceLayers subresourceLayers(uint32_t mipLevel) {
+    VkImageSubresourceLayers layers = {};
+    layers.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    layers.mipLevel = mipLevel;
+    layers.baseArrayLayer = 0;
+    layers.layerCount = 1;
+    return layers;
+  }
+
+  void memoryBarrier(VkCommandBuffer commandBuffer, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage) {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  }
+} // namespace
+
+
+ResidentImage::ResidentImage(Device* device, VkExtent2D extent, VkFormat format, uint32_t mipLevels, VkImageUsageFlags usage)
+  : device(device), extent(extent), format(format), mipLevels(std::max(1u, mipLevels)),
+    usage(usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT), texelSize(formatTexelSize(format)),
+    image(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), residentLevel(0), heapIndex(0)
+{
+  VkDeviceSize residentSize = replaceImage(0);
+  residencyId = device->GetResidencyManager()->Register(heapIndex, residentSize,
+    [this](VkDeviceSize residentSize) { return demote(residentSize); });
+}
+
+ResidentImage::~ResidentImage() {
+  device->GetResidencyManager()->Unregister(residencyId);
+  vkDestroyImage(device->GetVkDevice(), image, nullptr);
+  device->FreeMemory(memory);
+}
+
+VkExtent2D ResidentImage::GetMipExtent(uint32_t level) const {
+  return { std::max(1u, extent.width >> level), std::max(1u, extent.height >> level) };
+}
+
+VkDeviceSize ResidentImage::GetMipSize(uint32_t level) const {
+  VkExtent2D mipExtent = GetMipExtent(level);
+  return static_cast<VkDeviceSize>(mipExtent.width) * mipExtent.height * texelSize;
+}
+
+void ResidentImage::Touch() {
+  device->GetResidencyManager()->Touch(residencyId);
+}
+
+void ResidentImage::Restore() {
+  if (residentLevel == 0) {
+    return;
+  }
+  device->GetResidencyManager()->SetResidentSize(residencyId, replaceImage(0));
+}
+
+void ResidentImage::Upload(uint32_t level, const void* data) {
+  transfer(level, data, nullptr);
+}
+
+void ResidentImage::Download(uint32_t level, void* data) {
+  transfer(level, nullptr, data);
+}
+
+VkDeviceSize ResidentImage::demote(VkDeviceSize residentSize) {
+  // The smallest level always stays
+  if (residentLevel + 1 >= mipLevels) {
+    return residentSize;
+  }
+  return replaceImage(residentLevel + 1);
+}
+
+VkDeviceSize ResidentImage::replaceImage(uint32_t newLevel) {
+  VkDevice vkDevice = device->GetVkDevice();
+  VkExtent2D newExtent = GetMipExtent(newLevel);
+
+  VkImageCreateInfo imageInfo = {};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = format;
+  imageInfo.extent = { newExtent.width, newExtent.height, 1 };
+  imageInfo.mipLevels = mipLevels - newLevel;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = usage;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VkImage newImage;
+  if (vkCreateImage(vkDevice, &imageInfo, nullptr, &newImage) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create image");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(vkDevice, newImage, &requirements);
+
+  VkDeviceMemory newMemory;
+  uint32_t typeIndex;
+  try {
+    typeIndex = device->FindMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    newMemory = device->AllocateMemory(requirements.size, typeIndex);
+  } catch (...) {
+    vkDestroyImage(vkDevice, newImage, nullptr);
+    throw;
+  }
+  vkBindImageMemory(vkDevice, newImage, newMemory, 0);
+
+  try {
+    device->ExecuteOnce(imageQueue(device), [&](VkCommandBuffer commandBuffer) {
+      VkImageMemoryBarrier barrier = {};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = newImage;
+      barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, imageInfo.mipLevels, 0, 1 };
+      vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+      // Levels both images hold, each image counts its levels from its own top
+      std::vector<VkImageCopy> regions;
+      for (uint32_t level = std::max(newLevel, residentLevel); image != VK_NULL_HANDLE && level < mipLevels; level++)
+      {
+        VkExtent2D mipExtent = GetMipExtent(level);
+        VkImageCopy region = {};
+        region.srcSubresource = subresourceLayers(level - residentLevel);
+        region.dstSubresource = subresourceLayers(level - newLevel);
+        region.extent = { mipExtent.width, mipExtent.height, 1 };
+        regions.push_back(region);
+      }
+      if (!regions.empty()) {
+        vkCmdCopyImage(commandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, newImage, VK_IMAGE_LAYOUT_GENERAL,
+          static_cast<uint32_t>(regions.size()), regions.data());
+      }
+
+      memoryBarrier(commandBuffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    });
+  } catch (...) {
+    vkDestroyImage(vkDevice, newImage, nullptr);
+    device->FreeMemory(newMemory);
+    throw;
+  }
+
+  if (image != VK_NULL_HANDLE) {
+    vkDestroyImage(vkDevice, image, nullptr);
+    device->FreeMemory(memory);
+  }
+  image = newImage;
+  memory = newMemory;
+  residentLevel = newLevel;
+  heapIndex = device->GetMemoryProperties().memoryTypes[typeIndex].heapIndex;
+  return requirements.size;
+}
+
+void ResidentImage::transfer(uint32_t level, const void* uploadData, void* downloadData) {
+  VkDevice vkDevice = device->GetVkDevice();
+  bool upload = uploadData != nullptr;
+  if (level < residentLevel || level >= mipLevels) {
+    throw std::runtime_error("Mip level is not resident");
+  }
+  VkDeviceSize size = GetMipSize(level);
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer staging;
+  if (vkCreateBuffer(vkDevice, &bufferInfo, nullptr, &staging) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create staging buffer");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(vkDevice, staging, &requirements);
+  VkDeviceMemory stagingMemory;
+  try {
+    stagingMemory = device->AllocateMemory(requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  } catch (...) {
+    vkDestroyBuffer(vkDevice, staging, nullptr);
+    throw;
+  }
+  vkBindBufferMemory(vkDevice, staging, stagingMemory, 0);
+
+  try {
+    void* mapped;
+    if (vkMapMemory(vkDevice, stagingMemory, 0, size, 0, &mapped) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to map staging buffer");
+    }
+    if (upload) {
+      std::memcpy(mapped, uploadData, static_cast<size_t>(size));
+    }
+
+    VkExtent2D mipExtent = GetMipExtent(level);
+    VkBufferImageCopy region = {};
+    region.imageSubresource = subresourceLayers(level - residentLevel);
+    region.imageExtent = { mipExtent.width, mipExtent.height, 1 };
+
+    device->ExecuteOnce(imageQueue(device), [&](VkCommandBuffer commandBuffer) {
+      if (upload) {
+        vkCmdCopyBufferToImage(commandBuffer, staging, image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+        memoryBarrier(commandBuffer, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+      } else {
+        vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, staging, 1, &region);
+        memoryBarrier(commandBuffer, VK_ACCESS_HOST_READ_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+      }
+    });
+
+    if (!upload) {
+      std::memcpy(downloadData, mapped, static_cast<size_t>(size));
+    }
+    vkUnmapMemory(vkDevice, stagingMemory);
+  } catch (...) {
+    vkDestroyBuffer(vkDevice, staging, nullptr);
+    device->FreeMemory(stagingMemory);
+    throw;
+  }
+
+  vkDestroyBuffer(vkDevice, staging, nullptr);
+  device->FreeMemory(stagingMemory);
+}
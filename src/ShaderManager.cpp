@@ -0,0 +1,460 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "ShaderManager.h"
+#include "Device.h"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+  constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+  uint64_t hashBytes(const void* bytes, size_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+    const uint8_t* data = static_cast<const uint8_t*>(bytes);
+    for (size_t i = 0; i < size; i++)
+    {
+      hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+  }
+
+  template <typename T>
+  void appendKey(std::vector<uint8_t>& key, const T& value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    key.insert(key.end(), bytes, bytes + sizeof(T));
+  }
+
+  /**
+   * @brief Read-only view of a SPIR-V file. Memory mapped so the kernel
+   *        pages it in straight from the page cache, read into a buffer on
+   *        Windows.
+   */
+  class SpirvFile
+  {
+  public:
+    explicit SpirvFile(const std::string& path) {
+#ifdef _WIN32
+      std::ifstream file(path, std::ios::ate | std::ios::binary);
+      if (!file.is_open()) {
+        throw std::runtime_error("Failed to open shader " + path);
+      }
+      size = static_cast<size_t>(file.tellg());
+      buffer.resize(size / sizeof(uint32_t));
+      file.seekg(0);
+      file.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(uint32_t));
+      code = buffer.data();
+#else
+      int descriptor = open(path.c_str(), O_RDONLY);
+      if (descriptor < 0) {
+        throw std::runtime_error("Failed to open shader " + path);
+      }
+
+      struct stat status;
+      if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+        close(descriptor);
+        throw std::runtime_error("Failed to read shader " + path);
+      }
+      size = static_cast<size_t>(status.st_size);
+
+      void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+      // The mapping keeps the file referenced, the descriptor is no longer needed
+      close(descriptor);
+      if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Failed to map shader " + path);
+      }
+      code = static_cast<const uint32_t*>(mapping);
+#endif
+      if (size % sizeof(uint32_t) != 0) {
+        release();
+        throw std::runtime_error("Shader " + path + " is not a whole number of SPIR-V words");
+      }
+    }
+
+    ~SpirvFile() {
+      release();
+    }
+
+    const uint32_t* GetCode() const { return code; }
+    size_t GetWordCount() const { return size / sizeof(uint32_t); }
+
+  private:
+    SpirvFile(const SpirvFile&) = delete;
+    SpirvFile& operator=(const SpirvFile&) = delete;
+
+    void release() {
+#ifndef _WIN32
+      if (code) {
+        munmap(const_cast<uint32_t*>(code), size);
+      }
+#endif
+      code = nullptr;
+    }
+
+    const uint32_t* code = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    std::vector<uint32_t> buffer;
+#endif
+  };
+
+  std::vector<uint8_t> descriptorSetLayoutKey(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+    std::vector<uint8_t> key;
+    for (const VkDescriptorSetLayoutBinding& binding : bindings)
+    {
+      appendKey(key, binding.binding);
+      appendKey(key, binding.descriptorType);
+      appendKey(key, binding.descriptorCount);
+      appendKey(key, binding.stageFlags);
+    }
+    return key;
+  }
+
+  std::vector<uint8_t> pipelineLayoutKey(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges) {
+    std::vector<uint8_t> key;
+    for (VkDescriptorSetLayout setLayout : setLayouts)
+    {
+      appendKey(key, setLayout);
+    }
+    for (const VkPushConstantRange& range : pushConstantRanges)
+    {
+      appendKey(key, range.stageFlags);
+      appendKey(key, range.offset);
+      appendKey(key, range.size);
+    }
+    return key;
+  }
+
+  template <typename Cache>
+  auto findCached(Cache& cache, uint64_t hash, const std::vector<uint8_t>& key) -> decltype(cache.begin()->second.handle) {
+    auto range = cache.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second.key == key) {
+        return it->second.handle;
+      }
+    }
+    return VK_NULL_HANDLE;
+  }
+} // namespace
+
+
+SpecializationConstants& SpecializationConstants::Set(uint32_t id, uint32_t value) {
+  values[id] = value;
+  return *this;
+}
+
+SpecializationConstants& SpecializationConstants::Set(uint32_t id, int32_t value) {
+  return Set(id, static_cast<uint32_t>(value));
+}
+
+SpecializationConstants& SpecializationConstants::Set(uint32_t id, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return Set(id, bits);
+}
+
+SpecializationConstants& SpecializationConstants::SetBool(uint32_t id, bool value) {
+  return Set(id, static_cast<uint32_t>(value ? VK_TRUE : VK_FALSE));
+}
+
+uint64_t SpecializationConstants::Hash() const {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (const auto& entry : values)
+  {
+    hash = hashBytes(&entry.first, sizeof(entry.first), hash);
+    hash = hashBytes(&entry.second, sizeof(entry.second), hash);
+  }
+  return hash;
+}
+
+
+ShaderManager::ShaderManager(Device* device)
+  : device(device)
+{
+}
+
+ShaderManager::~ShaderManager() {
+  VkDevice vkDevice = device->GetVkDevice();
+
+  for (auto& entry : variants)
+  {
+    if (entry.second->computePipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(vkDevice, entry.second->computePipeline, nullptr);
+    }
+    delete entry.second;
+  }
+  for (auto& entry : modules)
+  {
+    vkDestroyShaderModule(vkDevice, entry.second->vkShaderModule, nullptr);
+    delete entry.second;
+  }
+  for (auto& entry : pipelineLayouts)
+  {
+    vkDestroyPipelineLayout(vkDevice, entry.second.handle, nullptr);
+  }
+  for (auto& entry : descriptorSetLayouts)
+  {
+    vkDestroyDescriptorSetLayout(vkDevice, entry.second.handle, nullptr);
+  }
+}
+
+const ShaderModule* ShaderManager::LoadModule(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = modules.find(path);
+  if (it != modules.end()) {
+    return it->second;
+  }
+
+  SpirvFile file(path);
+
+  ShaderModule* module = new ShaderModule();
+  module->path = path;
+  try {
+    module->reflection = ReflectSpirv(file.GetCode(), file.GetWordCount());
+
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = file.GetWordCount() * sizeof(uint32_t);
+    createInfo.pCode = file.GetCode();
+    if (vkCreateShaderModule(device->GetVkDevice(), &createInfo, nullptr, &module->vkShaderModule) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create shader module " + path);
+    }
+
+    for (const auto& bindings : module->reflection.descriptorSets)
+    {
+      module->descriptorSetLayouts.push_back(getDescriptorSetLayout(bindings));
+    }
+    module->pipelineLayout = getPipelineLayout(module->descriptorSetLayouts, module->reflection.pushConstantRanges);
+  } catch (...) {
+    // Layouts already made stay in the cache, they are shared anyway
+    if (module->vkShaderModule != VK_NULL_HANDLE) {
+      vkDestroyShaderModule(device->GetVkDevice(), module->vkShaderModule, nullptr);
+    }
+    delete module;
+    throw;
+  }
+
+  modules[path] = module;
+  stats.modules++;
+  return module;
+}
+
+const ShaderVariant* ShaderManager::GetVariant(const ShaderModule* module, const SpecializationConstants& constants) {
+  // Drop constants the shader does not have so they cannot split otherwise identical variants
+  SpecializationConstants used;
+  for (uint32_t id : module->reflection.specializationConstantIds)
+  {
+    auto value = constants.GetValues().find(id);
+    if (value != constants.GetValues().end()) {
+      used.Set(id, value->second);
+    }
+  }
+
+  uint64_t hash = used.Hash();
+  hash = hashBytes(&module, sizeof(module), hash);
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto range = variants.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (it->second->module == module && it->second->constants.GetValues() == used.GetValues()) {
+      stats.variantHits++;
+      return it->second;
+    }
+  }
+
+  ShaderVariant* variant = new ShaderVariant();
+  variant->module = module;
+  variant->constants = used;
+  for (const auto& entry : used.GetValues())
+  {
+    VkSpecializationMapEntry mapEntry = {};
+    mapEntry.constantID = entry.first;
+    mapEntry.offset = static_cast<uint32_t>(variant->data.size() * sizeof(uint32_t));
+    mapEntry.size = sizeof(uint32_t);
+    variant->mapEntries.push_back(mapEntry);
+    variant->data.push_back(entry.second);
+  }
+
+  variant->specializationInfo.mapEntryCount = static_cast<uint32_t>(variant->mapEntries.size());
+  variant->specializationInfo.pMapEntries = variant->mapEntries.data();
+  variant->specializationInfo.dataSize = variant->data.size() * sizeof(uint32_t);
+  variant->specializationInfo.pData = variant->data.data();
+
+  variant->stageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  variant->stageCreateInfo.stage = module->reflection.stage;
+  variant->stageCreateInfo.module = module->vkShaderModule;
+  variant->stageCreateInfo.pName = module->reflection.entryPoint.c_str();
+  variant->stageCreateInfo.pSpecializationInfo = variant->mapEntries.empty() ? nullptr : &variant->specializationInfo;
+
+  variants.emplace(hash, variant);
+  stats.variants++;
+  return variant;
+}
+
+VkPipeline ShaderManager::GetComputePipeline(const ShaderVariant* variant) {
+  if (variant->module->reflection.stage != VK_SHADER_STAGE_COMPUTE_BIT) {
+    throw std::runtime_error("Compute pipeline requested for a non-compute shader");
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (variant->computePipeline == VK_NULL_HANDLE) {
+    VkComputePipelineCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    createInfo.stage = variant->stageCreateInfo;
+    createInfo.layout = variant->module->pipelineLayout;
+
+    if (vkCreateComputePipelines(device->GetVkDevice(), VK_NULL_HANDLE, 1, &createInfo, nullptr, &variant->computePipeline) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create compute pipeline for " + variant->module->path);
+    }
+    stats.computePipelines++;
+  }
+
+  return variant->computePipeline;
+}
+
+VkDescriptorSetLayout ShaderManager::GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return getDescriptorSetLayout(bindings);
+}
+
+VkPipelineLayout ShaderManager::GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges) {
+  std::lock_guard<std::mutex> lock(mutex);
+  return getPipelineLayout(setLayouts, pushConstantRanges);
+}
+
+VkPipelineLayout ShaderManager::GetPipelineLayout(const std::vector<const ShaderModule*>& modules) {
+  std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+  VkPushConstantRange pushConstants = {};
+  bool hasPushConstants = false;
+
+  for (const ShaderModule* module : modules)
+  {
+    const ShaderReflection& reflection = module->reflection;
+    if (sets.size() < reflection.descriptorSets.size()) {
+      sets.resize(reflection.descriptorSets.size());
+    }
+
+    for (size_t set = 0; set < reflection.descriptorSets.size(); set++)
+    {
+      for (const VkDescriptorSetLayoutBinding& binding : reflection.descriptorSets[set])
+      {
+        auto existing = std::find_if(sets[set].begin(), sets[set].end(), [&](const VkDescriptorSetLayoutBinding& other) {
+          return other.binding == binding.binding;
+        });
+        if (existing == sets[set].end()) {
+          sets[set].push_back(binding);
+        } else if (existing->descriptorType != binding.descriptorType || existing->descriptorCount != binding.descriptorCount) {
+          throw std::runtime_error("Shader stages disagree on a descriptor binding in " + module->path);
+        } else {
+          existing->stageFlags |= binding.stageFlags;
+        }
+      }
+    }
+
+    // One range covering every stage's block keeps the layout compatible with all of them
+    for (const VkPushConstantRange& range : reflection.pushConstantRanges)
+    {
+      if (!hasPushConstants) {
+        pushConstants = range;
+        hasPushConstants = true;
+      } else {
+        uint32_t end = std::max(pushConstants.offset + pushConstants.size, range.offset + range.size);
+        pushConstants.offset = std::min(pushConstants.offset, range.offset);
+        pushConstants.size = end - pushConstants.offset;
+        pushConstants.stageFlags |= range.stageFlags;
+      }
+    }
+  }
+
+  for (auto& bindings : sets)
+  {
+    std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+      return a.binding < b.binding;
+    });
+  }
+
+  std::vector<VkPushConstantRange> pushConstantRanges;
+  if (hasPushConstants) {
+    pushConstantRanges.push_back(pushConstants);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  return getPipelineLayout(sets, pushConstantRanges);
+}
+
+ShaderCacheStats ShaderManager::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  ShaderCacheStats current = stats;
+  current.descriptorSetLayouts = descriptorSetLayouts.size();
+  current.pipelineLayouts = pipelineLayouts.size();
+  return current;
+}
+
+VkDescriptorSetLayout ShaderManager::getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings) {
+  std::vector<uint8_t> key = descriptorSetLayoutKey(bindings);
+  uint64_t hash = hashBytes(key.data(), key.size());
+
+  VkDescriptorSetLayout layout = findCached(descriptorSetLayouts, hash, key);
+  if (layout != VK_NULL_HANDLE) {
+    stats.layoutHits++;
+    return layout;
+  }
+
+  VkDescriptorSetLayoutCreateInfo createInfo = {};
+  createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  createInfo.pBindings = bindings.data();
+  if (vkCreateDescriptorSetLayout(device->GetVkDevice(), &createInfo, nullptr, &layout) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create descriptor set layout");
+  }
+
+  descriptorSetLayouts.emplace(hash, CacheEntry<VkDescriptorSetLayout>{ layout, key });
+  return layout;
+}
+
+VkPipelineLayout ShaderManager::getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges) {
+  std::vector<uint8_t> key = pipelineLayoutKey(setLayouts, pushConstantRanges);
+  uint64_t hash = hashBytes(key.data(), key.size());
+
+  VkPipelineLayout layout = findCached(pipelineLayouts, hash, key);
+  if (layout != VK_NULL_HANDLE) {
+    stats.layoutHits++;
+    return layout;
+  }
+
+  VkPipelineLayoutCreateInfo createInfo = {};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  createInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+  createInfo.pSetLayouts = setLayouts.data();
+  createInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+  createInfo.pPushConstantRanges = pushConstantRanges.data();
+  if (vkCreatePipelineLayout(device->GetVkDevice(), &createInfo, nullptr, &layout) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to create pipeline layout");
+  }
+
+  pipelineLayouts.emplace(hash, CacheEntry<VkPipelineLayout>{ layout, key });
+  return layout;
+}
+
+VkPipelineLayout ShaderManager::getPipelineLayout(const std::vector<std::vector<VkDescriptorSetLayoutBinding>>& sets, const std::vector<VkPushConstantRange>& pushConstantRanges) {
+  std::vector<VkDescriptorSetLayout> setLayouts;
+  for (const auto& bindings : sets)
+  {
+    setLayouts.push_back(getDescriptorSetLayout(bindings));
+  }
+  return getPipelineLayout(setLayouts, pushConstantRanges);
+}
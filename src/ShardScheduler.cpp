@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include "ShardScheduler.h"
+
+namespace
+{
+  // Weight of the newest run in the throughput estimate
+  constexpr double THROUGHPUT_SMOOTHING = 0.5;
+
+  double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+    auto elapsed = std::chrono::high_resolution_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+  }
+} // namespace
+
+
+ShardScheduler::ShardScheduler(const std::vector<Device*>& devices, unsigned int chunksPerDevice)
+  : devices(devices), workers(devices.size()), chunksPerDevice(std::max(1u, chunksPerDevice)),
+    generation(0), stopping(false), function(nullptr), pendingChunks(0)
+{
+  if (devices.empty()) {
+    throw std::runtime_error("ShardScheduler needs at least one device");
+  }
+
+  for (Worker& worker : workers)
+  {
+    worker.stats.weight = 1.0 / workers.size();
+  }
+
+  // Workers are only started once the vector is final, they hold on to their index
+  for (unsigned int i = 0; i < workers.size(); i++)
+  {
+    workers[i].thread = std::thread(&ShardScheduler::workerLoop, this, i);
+  }
+}
+
+ShardScheduler::~ShardScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  workAvailable.notify_all();
+
+  for (Worker& worker : workers)
+  {
+    worker.thread.join();
+  }
+}
+
+void ShardScheduler::Run(size_t itemCount, const ShardFunction& function) {
+  std::lock_guard<std::mutex> runLock(runMutex);
+  if (itemCount == 0) {
+    return;
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  std::exception_ptr runError;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    splitItems(itemCount);
+    this->function = &function;
+    error = nullptr;
+    for (Worker& worker : workers)
+    {
+      worker.runItems = 0;
+      worker.runBusyMilliseconds = 0.0;
+    }
+
+    generation++;
+    workAvailable.notify_all();
+    runFinished.wait(lock, [this]() { return pendingChunks == 0; });
+
+    this->function = nullptr;
+    runError = error;
+    error = nullptr;
+
+    double elapsed = millisecondsSince(start);
+    for (Worker& worker : workers)
+    {
+      worker.stats.elapsedMilliseconds += elapsed;
+      worker.stats.utilization = worker.stats.busyMilliseconds / worker.stats.elapsedMilliseconds;
+    }
+
+    if (!runError) {
+      updateThroughput();
+    }
+  }
+
+  if (runError) {
+    std::rethrow_exception(runError);
+  }
+}
+
+std::vector<ShardDeviceStats> ShardScheduler::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::vector<ShardDeviceStats> stats;
+  stats.reserve(workers.size());
+  for (const Worker& worker : workers)
+  {
+    stats.push_back(worker.stats);
+  }
+  return stats;
+}
+
+void ShardScheduler::ResetStats() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (Worker& worker : workers)
+  {
+    ShardDeviceStats stats;
+    stats.throughput = worker.stats.throughput;
+    stats.weight = worker.stats.weight;
+    worker.stats = stats;
+  }
+}
+
+void ShardScheduler::splitItems(size_t itemCount) {
+  // Share boundaries from the cumulative weights, so the shares cover every item exactly once
+  double cumulativeWeight = 0.0;
+  size_t shareBegin = 0;
+  for (unsigned int i = 0; i < workers.size(); i++)
+  {
+    cumulativeWeight += workers[i].stats.weight;
+    size_t shareEnd = (i + 1 == workers.size())
+      ? itemCount
+      : std::min(itemCount, static_cast<size_t>(itemCount * cumulativeWeight + 0.5));
+    shareEnd = std::max(shareEnd, shareBegin);
+
+    Worker& worker = workers[i];
+    size_t shareSize = shareEnd - shareBegin;
+    size_t chunkSize = std::max<size_t>(1, (shareSize + chunksPerDevice - 1) / chunksPerDevice);
+    for (size_t begin = shareBegin; begin < shareEnd; begin += chunkSize)
+    {
+      worker.chunks.push_back({ begin, std::min(shareEnd, begin + chunkSize) });
+      pendingChunks++;
+    }
+    worker.queuedItems = shareSize;
+
+    shareBegin = shareEnd;
+  }
+}
+
+void ShardScheduler::updateThroughput() {
+  double measuredSum = 0.0;
+  unsigned int measuredCount = 0;
+  for (Worker& worker : workers)
+  {
+    if (worker.runItems > 0 && worker.runBusyMilliseconds > 0.0) {
+      double measured = worker.runItems / worker.runBusyMilliseconds;
+      worker.stats.throughput = worker.stats.throughput > 0.0
+        ? (1.0 - THROUGHPUT_SMOOTHING) * worker.stats.throughput + THROUGHPUT_SMOOTHING * measured
+        : measured;
+    }
+    if (worker.stats.throughput > 0.0) {
+      measuredSum += worker.stats.throughput;
+      measuredCount++;
+    }
+  }
+
+  if (measuredCount == 0) {
+    return;
+  }
+
+  // Devices that have not run anything yet are assumed to be average
+  double average = measuredSum / measuredCount;
+  double total = measuredSum + average * (workers.size() - measuredCount);
+  for (Worker& worker : workers)
+  {
+    double throughput = worker.stats.throughput > 0.0 ? worker.stats.throughput : average;
+    worker.stats.weight = throughput / total;
+  }
+}
+
+bool ShardScheduler::takeChunk(unsigned int index, Chunk& chunk, bool& stolen) {
+  Worker* source = &workers[index];
+  stolen = false;
+
+  if (source->chunks.empty()) {
+    // Steal from whoever has the most work left
+    source = nullptr;
+    for (Worker& worker : workers)
+    {
+      if (!worker.chunks.empty() && (!source || worker.queuedItems > source->queuedItems)) {
+        source = &worker;
+      }
+    }
+    if (!source) {
+      return false;
+    }
+    stolen = true;
+  }
+
+  // Owners work front to back and thieves back to front, keeping each owner's items contiguous
+  if (stolen) {
+    chunk = source->chunks.back();
+    source->chunks.pop_back();
+  } else {
+    chunk = source->chunks.front();
+    source->chunks.pop_front();
+  }
+  source->queuedItems -= chunk.end - chunk.begin;
+  return true;
+}
+
+void ShardScheduler::workerLoop(unsigned int index) {
+  unsigned long long seenGeneration = 0;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    workAvailable.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+    if (stopping) {
+      return;
+    }
+    seenGeneration = generation;
+
+    Chunk chunk;
+    bool stolen;
+    while (takeChunk(index, chunk, stolen)) {
+      const ShardFunction& run = *function;
+      lock.unlock();
+
+      std::exception_ptr chunkError;
+      auto start = std::chrono::high_resolution_clock::now();
+      try {
+        run(index, devices[index], chunk.begin, chunk.end);
+      } catch (...) {
+        chunkError = std::current_exception();
+      }
+      double busy = millisecondsSince(start);
+
+      lock.lock();
+      Worker& worker = workers[index];
+      worker.runItems += chunk.end - chunk.begin;
+      worker.runBusyMilliseconds += busy;
+      worker.stats.chunks++;
+      worker.stats.items += chunk.end - chunk.begin;
+      worker.stats.busyMilliseconds += busy;
+      if (stolen) {
+        worker.stats.stolenChunks++;
+      }
+
+      if (chunkError) {
+        if (!error) {
+          error = chunkError;
+        }
+        // Drop the rest of the run
+        for (Worker& other : workers)
+        {
+          pendingChunks -= other.chunks.size();
+          other.chunks.clear();
+          other.queuedItems = 0;
+        }
+      }
+
+      if (--pendingChunks == 0) {
+        runFinished.notify_all();
+      }
+    }
+  }
+}
@@ -0,0 +1,517 @@
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include "SpirvReflection.h"
+
+namespace
+{
+  constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+  constexpr size_t SPIRV_HEADER_WORDS = 5;
+
+  // Opcodes, decorations and enumerants from the SPIR-V specification, only the ones reflection reads
+  enum Op : uint32_t {
+    OpEntryPoint = 15,
+    OpExecutionMode = 16,
+    OpTypeBool = 20,
+    OpTypeInt = 21,
+    OpTypeFloat = 22,
+    OpTypeVector = 23,
+    OpTypeMatrix = 24,
+    OpTypeImage = 25,
+    OpTypeSampler = 26,
+    OpTypeSampledImage = 27,
+    OpTypeArray = 28,
+    OpTypeRuntimeArray = 29,
+    OpTypeStruct = 30,
+    OpTypePointer = 32,
+    OpConstantTrue = 41,
+    OpConstantFalse = 42,
+    OpConstant = 43,
+    OpConstantComposite = 44,
+    OpSpecConstantTrue = 48,
+    OpSpecConstantFalse = 49,
+    OpSpecConstant = 50,
+    OpSpecConstantComposite = 51,
+    OpVariable = 59,
+    OpDecorate = 71,
+    OpMemberDecorate = 72,
+    OpExecutionModeId = 331,
+    OpTypeAccelerationStructureKHR = 5341,
+  };
+
+  enum Decoration : uint32_t {
+    DecorationSpecId = 1,
+    DecorationBufferBlock = 3,
+    DecorationArrayStride = 6,
+    DecorationMatrixStride = 7,
+    DecorationBuiltIn = 11,
+    DecorationBinding = 33,
+    DecorationDescriptorSet = 34,
+    DecorationOffset = 35,
+  };
+
+  enum StorageClass : uint32_t {
+    StorageClassUniformConstant = 0,
+    StorageClassUniform = 2,
+    StorageClassPushConstant = 9,
+    StorageClassStorageBuffer = 12,
+  };
+
+  constexpr uint32_t BUILT_IN_WORKGROUP_SIZE = 25;
+  constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE = 17;
+  constexpr uint32_t EXECUTION_MODE_LOCAL_SIZE_ID = 38;
+  constexpr uint32_t DIM_BUFFER = 5;
+  constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+  // Vulkan implementations support at most this many, anything above is a malformed module
+  constexpr uint32_t MAX_DESCRIPTOR_SETS = 32;
+
+  // Deeper type nesting than any real shader uses, a type that refers to itself would recurse forever
+  constexpr uint32_t MAX_TYPE_DEPTH = 64;
+
+  struct Instruction
+  {
+    uint32_t opcode;
+    const uint32_t* words;
+    uint32_t wordCount;
+  };
+
+  struct Decorations
+  {
+    int32_t set = -1;
+    int32_t binding = -1;
+    int32_t specId = -1;
+    int32_t builtIn = -1;
+    uint32_t arrayStride = 0;
+    bool bufferBlock = false;
+  };
+
+  struct MemberDecorations
+  {
+    uint32_t offset = 0;
+    uint32_t matrixStride = 0;
+  };
+
+  /**
+   * Everything reflection needs, indexed by result id. Types and constants
+   * are defined after the decorations that refer to them, so the module is
+   * read in full before anything is resolved.
+   */
+  struct Module
+  {
+    std::unordered_map<uint32_t, Instruction> definitions;
+    std::unordered_map<uint32_t, Decorations> decorations;
+    std::unordered_map<uint32_t, std::map<uint32_t, MemberDecorations>> memberDecorations;
+    std::vector<Instruction> variables;
+
+    const Instruction& Definition(uint32_t id) const {
+      auto it = definitions.find(id);
+      if (it == definitions.end()) {
+        throw std::runtime_error("SPIR-V refers to an undefined id");
+      }
+      return it->second;
+    }
+
+    Decorations GetDecorations(uint32_t id) const {
+      auto it = decorations.find(id);
+      return it == decorations.end() ? Decorations() : it->second;
+    }
+
+    uint32_t ConstantValue(uint32_t id) const {
+      const Instruction& constant = Definition(id);
+      switch (constant.opcode) {
+        case OpConstant:
+        case OpSpecConstant:
+          return constant.words[3];
+        case OpConstantTrue:
+        case OpSpecConstantTrue:
+          return 1;
+        case OpConstantFalse:
+        case OpSpecConstantFalse:
+          return 0;
+        default:
+          throw std::runtime_error("SPIR-V constant is not a scalar");
+      }
+    }
+
+    uint32_t TypeSize(uint32_t typeId, uint32_t matrixStride = 0, uint32_t depth = 0) const {
+      if (depth > MAX_TYPE_DEPTH) {
+        throw std::runtime_error("SPIR-V types are nested too deeply");
+      }
+
+      const Instruction& type = Definition(typeId);
+      switch (type.opcode) {
+        case OpTypeBool:
+          return 4;
+        case OpTypeInt:
+        case OpTypeFloat:
+          return type.words[2] / 8;
+        case OpTypeVector:
+          return type.words[3] * TypeSize(type.words[2], 0, depth + 1);
+        case OpTypeMatrix:
+          return type.words[3] * (matrixStride ? matrixStride : TypeSize(type.words[2], 0, depth + 1));
+        case OpTypeArray: {
+          uint32_t stride = GetDecorations(typeId).arrayStride;
+          return ConstantValue(type.words[3]) * (stride ? stride : TypeSize(type.words[2], 0, depth + 1));
+        }
+        case OpTypeStruct: {
+          uint32_t size = 0;
+          auto members = memberDecorations.find(typeId);
+          for (uint32_t member = 0; member + 2 < type.wordCount; member++)
+          {
+            MemberDecorations decoration;
+            if (members != memberDecorations.end() && members->second.count(member)) {
+              decoration = members->second.at(member);
+            }
+            size = std::max(size, decoration.offset + TypeSize(type.words[2 + member], decoration.matrixStride, depth + 1));
+          }
+          return size;
+        }
+        default:
+          throw std::runtime_error("SPIR-V push constant member has a type without a known size");
+      }
+    }
+  };
+
+  /**
+   * @brief Fewest words, opcode word included, an instruction reflection
+   *        reads must have. Every operand read by index is covered, so a
+   *        malformed module cannot make reflection read past an instruction.
+   */
+  uint32_t minimumWordCount(uint32_t opcode) {
+    switch (opcode) {
+      case OpTypeBool:
+      case OpTypeSampler:
+      case OpTypeStruct:
+      case OpTypeAccelerationStructureKHR:
+        return 2;
+      case OpExecutionMode:
+      case OpExecutionModeId:
+      case OpTypeFloat:
+      case OpTypeSampledImage:
+      case OpTypeRuntimeArray:
+      case OpConstantTrue:
+      case OpConstantFalse:
+      case OpConstantComposite:
+      case OpSpecConstantTrue:
+      case OpSpecConstantFalse:
+      case OpSpecConstantComposite:
+      case OpDecorate:
+        return 3;
+      case OpEntryPoint:
+      case OpTypeInt:
+      case OpTypeVector:
+      case OpTypeMatrix:
+      case OpTypeArray:
+      case OpTypePointer:
+      case OpConstant:
+      case OpSpecConstant:
+      case OpVariable:
+      case OpMemberDecorate:
+        return 4;
+      case OpTypeImage:
+        return 9;
+      default:
+        return 1;
+    }
+  }
+
+  /**
+   * @brief Entry point name, a nul terminated string packed into the
+   *        instruction's words from wordIndex on
+   */
+  std::string readString(const uint32_t* words, uint32_t wordCount, uint32_t wordIndex) {
+    const char* begin = reinterpret_cast<const char*>(words + wordIndex);
+    const char* end = begin + (wordCount - wordIndex) * sizeof(uint32_t);
+    const char* terminator = std::find(begin, end, '\0');
+    if (terminator == end) {
+      throw std::runtime_error("SPIR-V string is not terminated");
+    }
+    return std::string(begin, terminator);
+  }
+
+  VkShaderStageFlagBits stageFromExecutionModel(uint32_t executionModel) {
+    switch (executionModel) {
+      case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+      case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+      case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+      case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+      case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+      case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+      default:
+        throw std::runtime_error("Unsupported SPIR-V execution model");
+    }
+  }
+
+  /**
+   * @brief Descriptor type of a resource variable and how many descriptors
+   *        its arrays add up to
+   */
+  VkDescriptorType descriptorType(const Module& module, uint32_t storageClass, uint32_t typeId, uint32_t& descriptorCount) {
+    descriptorCount = 1;
+
+    const Instruction* type = &module.Definition(typeId);
+    for (uint32_t depth = 0; type->opcode == OpTypeArray || type->opcode == OpTypeRuntimeArray; depth++) {
+      if (depth == MAX_TYPE_DEPTH) {
+        throw std::runtime_error("SPIR-V types are nested too deeply");
+      }
+      // Runtime arrays need descriptor indexing, a layout can only declare one descriptor for them
+      if (type->opcode == OpTypeArray) {
+        descriptorCount *= module.ConstantValue(type->words[3]);
+      }
+      typeId = type->words[2];
+      type = &module.Definition(typeId);
+    }
+
+    switch (storageClass) {
+      case StorageClassStorageBuffer:
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      case StorageClassUniform:
+        // Before SPIR-V 1.3 storage buffers are Uniform blocks decorated BufferBlock
+        return module.GetDecorations(typeId).bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      default:
+        break;
+    }
+
+    switch (type->opcode) {
+      case OpTypeSampler:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+      case OpTypeSampledImage:
+        return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      case OpTypeImage: {
+        uint32_t dim = type->words[3];
+        bool sampled = type->words[7] == 1;
+        if (dim == DIM_SUBPASS_DATA) {
+          return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+        if (dim == DIM_BUFFER) {
+          return sampled ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+        }
+        return sampled ? VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      }
+      case OpTypeAccelerationStructureKHR:
+        return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+      default:
+        throw std::runtime_error("Unsupported SPIR-V resource type");
+    }
+  }
+} // namespace
+
+
+ShaderReflection ReflectSpirv(const uint32_t* code, size_t wordCount) {
+  if (wordCount < SPIRV_HEADER_WORDS || code[0] != SPIRV_MAGIC) {
+    throw std::runtime_error("Not a SPIR-V binary");
+  }
+
+  ShaderReflection reflection;
+  Module module;
+  bool haveEntryPoint = false;
+  std::vector<uint32_t> localSizeConstants;
+  uint32_t workgroupSizeId = 0;
+
+  // --- Read the instructions we care about ---
+  for (size_t offset = SPIRV_HEADER_WORDS; offset < wordCount;)
+  {
+    Instruction instruction;
+    instruction.opcode = code[offset] & 0xffff;
+    instruction.wordCount = code[offset] >> 16;
+    instruction.words = code + offset;
+    if (instruction.wordCount == 0 || offset + instruction.wordCount > wordCount) {
+      throw std::runtime_error("Truncated SPIR-V instruction");
+    }
+    if (instruction.wordCount < minimumWordCount(instruction.opcode)) {
+      throw std::runtime_error("Malformed SPIR-V instruction");
+    }
+    offset += instruction.wordCount;
+
+    const uint32_t* words = instruction.words;
+    switch (instruction.opcode) {
+      case OpEntryPoint:
+        if (!haveEntryPoint) {
+          reflection.stage = stageFromExecutionModel(words[1]);
+          reflection.entryPoint = readString(words, instruction.wordCount, 3);
+          haveEntryPoint = true;
+        }
+        break;
+
+      case OpExecutionMode:
+        if (words[2] == EXECUTION_MODE_LOCAL_SIZE && instruction.wordCount >= 6) {
+          std::copy(words + 3, words + 6, reflection.localSize);
+        }
+        break;
+
+      case OpExecutionModeId:
+        if (words[2] == EXECUTION_MODE_LOCAL_SIZE_ID && instruction.wordCount >= 6) {
+          localSizeConstants.assign(words + 3, words + 6);
+        }
+        break;
+
+      case OpDecorate: {
+        Decorations& decorations = module.decorations[words[1]];
+        if (words[2] == DecorationBufferBlock) {
+          decorations.bufferBlock = true;
+          break;
+        }
+
+        bool readsOperand = words[2] == DecorationSpecId || words[2] == DecorationArrayStride || words[2] == DecorationBuiltIn ||
+          words[2] == DecorationBinding || words[2] == DecorationDescriptorSet;
+        if (!readsOperand) {
+          break;
+        }
+        if (instruction.wordCount < 4) {
+          throw std::runtime_error("SPIR-V decoration is missing its operand");
+        }
+
+        switch (words[2]) {
+          case DecorationSpecId: decorations.specId = static_cast<int32_t>(words[3]); break;
+          case DecorationArrayStride: decorations.arrayStride = words[3]; break;
+          case DecorationBuiltIn: decorations.builtIn = static_cast<int32_t>(words[3]); break;
+          case DecorationBinding: decorations.binding = static_cast<int32_t>(words[3]); break;
+          case DecorationDescriptorSet: decorations.set = static_cast<int32_t>(words[3]); break;
+          default: break;
+        }
+        if (words[2] == DecorationBuiltIn && words[3] == BUILT_IN_WORKGROUP_SIZE) {
+          workgroupSizeId = words[1];
+        }
+        break;
+      }
+
+      case OpMemberDecorate:
+        if ((words[3] == DecorationOffset || words[3] == DecorationMatrixStride) && instruction.wordCount < 5) {
+          throw std::runtime_error("SPIR-V decoration is missing its operand");
+        }
+        if (words[3] == DecorationOffset) {
+          module.memberDecorations[words[1]][words[2]].offset = words[4];
+        } else if (words[3] == DecorationMatrixStride) {
+          module.memberDecorations[words[1]][words[2]].matrixStride = words[4];
+        }
+        break;
+
+      case OpTypeBool:
+      case OpTypeInt:
+      case OpTypeFloat:
+      case OpTypeVector:
+      case OpTypeMatrix:
+      case OpTypeImage:
+      case OpTypeSampler:
+      case OpTypeSampledImage:
+      case OpTypeArray:
+      case OpTypeRuntimeArray:
+      case OpTypeStruct:
+      case OpTypePointer:
+      case OpTypeAccelerationStructureKHR:
+        module.definitions[words[1]] = instruction;
+        break;
+
+      case OpConstantTrue:
+      case OpConstantFalse:
+      case OpConstant:
+      case OpConstantComposite:
+      case OpSpecConstantTrue:
+      case OpSpecConstantFalse:
+      case OpSpecConstant:
+      case OpSpecConstantComposite:
+        module.definitions[words[2]] = instruction;
+        break;
+
+      case OpVariable:
+        module.variables.push_back(instruction);
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  if (!haveEntryPoint) {
+    throw std::runtime_error("SPIR-V has no entry point");
+  }
+
+  // --- Specialization constants ---
+  for (const auto& entry : module.decorations)
+  {
+    if (entry.second.specId >= 0) {
+      reflection.specializationConstantIds.push_back(static_cast<uint32_t>(entry.second.specId));
+    }
+  }
+  std::sort(reflection.specializationConstantIds.begin(), reflection.specializationConstantIds.end());
+
+  // --- Workgroup size, the WorkgroupSize built-in overrides the execution mode ---
+  if (workgroupSizeId != 0) {
+    const Instruction& composite = module.Definition(workgroupSizeId);
+    if (composite.opcode != OpConstantComposite && composite.opcode != OpSpecConstantComposite) {
+      throw std::runtime_error("SPIR-V WorkgroupSize is not a composite constant");
+    }
+    localSizeConstants.assign(composite.words + 3, composite.words + std::min<uint32_t>(composite.wordCount, 6));
+  }
+  for (size_t i = 0; i < localSizeConstants.size() && i < 3; i++)
+  {
+    reflection.localSize[i] = module.ConstantValue(localSizeConstants[i]);
+    reflection.localSizeIds[i] = module.GetDecorations(localSizeConstants[i]).specId;
+  }
+
+  // --- Resources ---
+  for (const Instruction& variable : module.variables)
+  {
+    uint32_t id = variable.words[2];
+    uint32_t storageClass = variable.words[3];
+    const Instruction& pointer = module.Definition(variable.words[1]);
+    if (pointer.opcode != OpTypePointer) {
+      throw std::runtime_error("SPIR-V variable does not have a pointer type");
+    }
+    uint32_t typeId = pointer.words[3];
+
+    if (storageClass == StorageClassPushConstant) {
+      VkPushConstantRange range = {};
+      range.stageFlags = reflection.stage;
+
+      // The range starts at the first member, blocks may leave room for other stages before it
+      auto members = module.memberDecorations.find(typeId);
+      uint32_t start = UINT32_MAX;
+      if (members != module.memberDecorations.end()) {
+        for (const auto& member : members->second)
+        {
+          start = std::min(start, member.second.offset);
+        }
+      }
+      range.offset = start == UINT32_MAX ? 0 : start;
+      range.size = module.TypeSize(typeId) - range.offset;
+      reflection.pushConstantRanges.push_back(range);
+      continue;
+    }
+
+    if (storageClass != StorageClassUniformConstant && storageClass != StorageClassUniform && storageClass != StorageClassStorageBuffer) {
+      continue;
+    }
+
+    Decorations decorations = module.GetDecorations(id);
+    if (decorations.binding < 0) {
+      continue;
+    }
+    uint32_t set = decorations.set < 0 ? 0 : static_cast<uint32_t>(decorations.set);
+    if (set >= MAX_DESCRIPTOR_SETS) {
+      throw std::runtime_error("SPIR-V descriptor set index is out of range");
+    }
+
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = static_cast<uint32_t>(decorations.binding);
+    binding.descriptorType = descriptorType(module, storageClass, typeId, binding.descriptorCount);
+    binding.stageFlags = reflection.stage;
+
+    if (reflection.descriptorSets.size() <= set) {
+      reflection.descriptorSets.resize(set + 1);
+    }
+    reflection.descriptorSets[set].push_back(binding);
+  }
+
+  for (auto& bindings : reflection.descriptorSets)
+  {
+    std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+      return a.binding < b.binding;
+    });
+  }
+
+  return reflection;
+}
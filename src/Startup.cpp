@@ -0,0 +1,151 @@
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include "Startup.h"
+#include "Device.h"
+#include "Instance.h"
+#include "SwapChain.h"
+#include "Window.h"
+
+namespace
+{
+  using Clock = std::chrono::high_resolution_clock;
+
+  double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  std::vector<const char*> getGLFWExtensions() {
+    uint32_t glfwExtensionCount = 0;
+    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    return std::vector<const char*>(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
+
+  /**
+   * @brief Instance, physical device and logical device, without a surface.
+   *        Present support is checked through GLFW instead.
+   */
+  void createInstanceAndDevice(const StartupOptions& options, std::vector<const char*> instanceExtensions, StartupContext& context) {
+    auto start = Clock::now();
+    context.instance = new Instance(options.applicationName, static_cast<unsigned int>(instanceExtensions.size()), instanceExtensions.data());
+    context.timings.instanceMilliseconds = millisecondsSince(start);
+
+    start = Clock::now();
+    context.instance->PickPhysicalDevice(options.deviceExtensions, options.requiredQueues, VK_NULL_HANDLE);
+    context.timings.physicalDeviceMilliseconds = millisecondsSince(start);
+
+    start = Clock::now();
+    context.device = context.instance->CreateDevice(options.requiredQueues, options.deviceFeatures);
+    context.timings.deviceMilliseconds = millisecondsSince(start);
+  }
+
+  void createSurface(StartupContext& context) {
+    auto start = Clock::now();
+    if (glfwCreateWindowSurface(context.instance->GetVkInstance(), GetGLFWWindow(), nullptr, &context.surface) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create window surface");
+    }
+    context.timings.surfaceMilliseconds = millisecondsSince(start);
+  }
+
+  void createSwapChain(const StartupOptions& options, StartupContext& context) {
+    auto start = Clock::now();
+    context.swapChain = context.device->CreateSwapChain(context.surface, options.swapChainBuffers);
+    context.timings.swapChainMilliseconds = millisecondsSince(start);
+  }
+
+  void createWindow(const StartupOptions& options, StartupContext& context) {
+    auto start = Clock::now();
+    CreateGLFWWindow(options.width, options.height, options.applicationName);
+    context.timings.windowMilliseconds = millisecondsSince(start);
+  }
+
+  void initializeSequential(const StartupOptions& options, StartupContext& context) {
+    createWindow(options, context);
+
+    auto start = Clock::now();
+    std::vector<const char*> instanceExtensions = getGLFWExtensions();
+    context.instance = new Instance(options.applicationName, static_cast<unsigned int>(instanceExtensions.size()), instanceExtensions.data());
+    context.timings.instanceMilliseconds = millisecondsSince(start);
+
+    createSurface(context);
+
+    start = Clock::now();
+    context.instance->PickPhysicalDevice(options.deviceExtensions, options.requiredQueues, context.surface);
+    context.timings.physicalDeviceMilliseconds = millisecondsSince(start);
+
+    start = Clock::now();
+    context.device = context.instance->CreateDevice(options.requiredQueues, options.deviceFeatures);
+    context.timings.deviceMilliseconds = millisecondsSince(start);
+
+    createSwapChain(options, context);
+  }
+
+  void initializeParallel(const StartupOptions& options, StartupContext& context) {
+    // The extension list needs glfwInit but no window, so the worker can start right away
+    std::vector<const char*> instanceExtensions = getGLFWExtensions();
+
+    std::exception_ptr workerError;
+    std::thread worker([&]() {
+      try {
+        createInstanceAndDevice(options, instanceExtensions, context);
+      } catch (...) {
+        workerError = std::current_exception();
+      }
+    });
+
+    std::exception_ptr windowError;
+    try {
+      createWindow(options, context);
+    } catch (...) {
+      windowError = std::current_exception();
+    }
+    worker.join();
+
+    if (workerError) {
+      std::rethrow_exception(workerError);
+    }
+    if (windowError) {
+      std::rethrow_exception(windowError);
+    }
+
+    createSurface(context);
+    createSwapChain(options, context);
+  }
+} // namespace
+
+
+StartupContext InitializeVulkan(const StartupOptions& options) {
+  StartupContext context;
+  auto start = Clock::now();
+
+  try {
+    auto glfwStart = Clock::now();
+    InitializeGLFW();
+    context.timings.glfwMilliseconds = millisecondsSince(glfwStart);
+
+    if (options.parallel) {
+      initializeParallel(options, context);
+    } else {
+      initializeSequential(options, context);
+    }
+  } catch (...) {
+    DestroyVulkan(context);
+    throw;
+  }
+
+  context.timings.totalMilliseconds = millisecondsSince(start);
+  return context;
+}
+
+void DestroyVulkan(StartupContext& context) {
+  delete context.swapChain;
+  delete context.device;
+  if (context.surface != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(context.instance->GetVkInstance(), context.surface, nullptr);
+  }
+  delete context.instance;
+  DestroyWindow();
+
+  context = StartupContext();
+}
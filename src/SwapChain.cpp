@@ -79,27 +79,34 @@ namespace
 } // namespace
 
 
-SwapChain::SwapChain(Device* device, VkSurfaceKHR vkSurface, unsigned int numBuffers)
-  : device(device), vkSurface(vkSurface), numBuffers(numBuffers) {
+SwapChain::SwapChain(Device* device, VkSurfaceKHR vkSurface, unsigned int numBuffers, GLFWwindow* window)
+  : device(device), vkSurface(vkSurface), numBuffers(numBuffers), window(window),
+    vkSwapChain(VK_NULL_HANDLE), recreatePending(false), vkSwapChainImageUsage(0) {
 
-  Create();
+  // A window created minimized gets its swap chain once it is restored
+  recreatePending = !Create(VK_NULL_HANDLE);
 
-  VkSemaphoreCreateInfo semaphoreInfo = {};
-  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-  if (vkCreateSemaphore(device->GetVkDevice(), &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-      vkCreateSemaphore(device->GetVkDevice(), &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS) {
-    throw std::runtime_error("Failed to create semaphores");
-  }
+  imageAvailableSemaphore = device->GetSyncPool()->AcquireSemaphore();
+  renderFinishedSemaphore = device->GetSyncPool()->AcquireSemaphore();
 }
 
-void SwapChain::Create() {
-  auto* instance = device->GetInstance();
+bool SwapChain::Create(VkSwapchainKHR oldSwapChain) {
+  if (!device->SupportsPresent(vkSurface)) {
+    throw std::runtime_error("Present queue cannot present to surface");
+  }
 
-  const auto& surfaceCapabilities = instance->GetSurfaceCapabilities();
-  VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(instance->GetSurfaceFormats());
-  VkPresentModeKHR presentMode = chooseSwapPresentMode(instance->GetPresentModes());
-  VkExtent2D extent = chooseSwapExtent(surfaceCapabilities, GetGLFWWindow());
+  const SurfaceSupport surfaceSupport = device->QuerySurfaceSupport(vkSurface);
+  if (surfaceSupport.formats.empty() || surfaceSupport.presentModes.empty()) {
+    throw std::runtime_error("Surface has no formats or present modes");
+  }
+  const auto& surfaceCapabilities = surfaceSupport.capabilities;
+  VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(surfaceSupport.formats);
+  VkPresentModeKHR presentMode = chooseSwapPresentMode(surfaceSupport.presentModes);
+  VkExtent2D extent = chooseSwapExtent(surfaceCapabilities, window);
+  if (extent.width == 0 || extent.height == 0) {
+    // Minimized, a swap chain cannot have a zero extent
+    return false;
+  }
 
   uint32_t imageCount = surfaceCapabilities.minImageCount + 1;
   imageCount = numBuffers > imageCount ? numBuffers : imageCount;
@@ -122,9 +129,11 @@ void SwapChain::Create() {
   createInfo.presentMode = presentMode;
   createInfo.imageExtent = extent;
   createInfo.imageArrayLayers = 1;
-  createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  // Transfer destination lets the images be cleared or blitted to without a render pass, where supported
+  createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+    (surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
-  const auto& queueFamilyIndices = instance->GetQueueFamilyIndices();
+  const auto& queueFamilyIndices = device->GetQueueFamilyIndices();
   if (queueFamilyIndices[QueueFlags::Graphics] != queueFamilyIndices[QueueFlags::Present]) {
     // Images can be used across the multiply queue families without explicit ownership transfers
     createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
@@ -152,8 +161,8 @@ void SwapChain::Create() {
   // Specify presentation mode
   createInfo.presentMode = presentMode;
 
-  // Reference to old swap chain in case current one becomes invalid
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // Hand over from the retiring swap chain, which keeps its presented images on screen until the new one presents
+  createInfo.oldSwapchain = oldSwapChain;
 
   // Create swap chain
   if (vkCreateSwapchainKHR(device->GetVkDevice(), &createInfo, nullptr, &vkSwapChain) != VK_SUCCESS) {
@@ -167,16 +176,105 @@ void SwapChain::Create() {
 
   vkSwapChainImageFormat = surfaceFormat.format;
   vkSwapChainExtent = extent;
+  vkSwapChainImageUsage = createInfo.imageUsage;
+  return true;
 }
 
 void SwapChain::Destroy() {
-  vkDestroySwapchainKHR(device->GetVkDevice(), vkSwapChain, nullptr);
+  if (vkSwapChain != VK_NULL_HANDLE) {
+    vkDestroySwapchainKHR(device->GetVkDevice(), vkSwapChain, nullptr);
+    vkSwapChain = VK_NULL_HANDLE;
+  }
+}
+
+SwapChain::~SwapChain() {
+  // The semaphores may still have a pending acquire signal or present wait,
+  // they can only go back to the pool once nothing uses them
+  vkDeviceWaitIdle(device->GetVkDevice());
+  Destroy();
+  device->GetSyncPool()->ReleaseSemaphore(imageAvailableSemaphore);
+  device->GetSyncPool()->ReleaseSemaphore(renderFinishedSemaphore);
+}
+
+VkResult SwapChain::Acquire() {
+  if (recreatePending && !Recreate()) {
+    return VK_NOT_READY;
+  }
+
+  VkResult result = vkAcquireNextImageKHR(device->GetVkDevice(), vkSwapChain, std::numeric_limits<uint64_t>::max(),
+    imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+
+  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+    if (!Recreate()) {
+      return VK_NOT_READY;
+    }
+    result = vkAcquireNextImageKHR(device->GetVkDevice(), vkSwapChain, std::numeric_limits<uint64_t>::max(),
+      imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+  }
+
+  if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+    throw std::runtime_error("Failed to acquire swap chain image");
+  }
+
+  return result;
+}
+
+bool SwapChain::Recreate() {
+  VkSwapchainKHR oldSwapChain = vkSwapChain;
+  recreatePending = !Create(oldSwapChain);
+  if (recreatePending) {
+    return false;
+  }
+
+  if (oldSwapChain != VK_NULL_HANDLE) {
+    // Submitted work may still use the retired images. The wait comes after
+    // the new swap chain exists, so the old images stay on screen meanwhile.
+    vkDeviceWaitIdle(device->GetVkDevice());
+    vkDestroySwapchainKHR(device->GetVkDevice(), oldSwapChain, nullptr);
+  }
+  return true;
 }
 
 VkSwapchainKHR SwapChain::GetVkSwapChain() const {
   return vkSwapChain;
 }
 
+VkFormat SwapChain::GetVkImageFormat() const {
+  return vkSwapChainImageFormat;
+}
+
 VkExtent2D SwapChain::GetVkExtent() const {
   return vkSwapChainExtent;
 }
+
+VkImageUsageFlags SwapChain::GetVkImageUsage() const {
+  return vkSwapChainImageUsage;
+}
+
+uint32_t SwapChain::GetIndex() const {
+  return imageIndex;
+}
+
+uint32_t SwapChain::GetCount() const {
+  return static_cast<uint32_t>(vkSwapChainImages.size());
+}
+
+VkImage SwapChain::GetVkImage(uint32_t index) const {
+  return vkSwapChainImages[index];
+}
+
+VkSurfaceKHR SwapChain::GetVkSurface() const {
+  return vkSurface;
+}
+
+GLFWwindow* SwapChain::GetWindow() const {
+  return window;
+}
+
+VkSemaphore SwapChain::GetImageAvailableVkSemaphore() const {
+  return imageAvailableSemaphore;
+}
+
+VkSemaphore SwapChain::GetRenderFinishedVkSemaphore() const {
+  return renderFinishedSemaphore;
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "SyncPool.h"
+#include "Device.h"
+
+namespace
+{
+  template <typename Pool, typename Create>
+  auto acquireObject(Pool& pool, Create create) -> decltype(create()) {
+    decltype(create()) object;
+    if (pool.available.empty()) {
+      object = create();
+      pool.objects.push_back(object);
+      pool.stats.created++;
+    } else {
+      object = pool.available.back();
+      pool.available.pop_back();
+    }
+
+#ifndef NDEBUG
+    pool.acquired.insert(object);
+#endif
+    pool.stats.live++;
+    pool.stats.peak = std::max(pool.stats.peak, pool.stats.live);
+    return object;
+  }
+
+  template <typename Pool, typename T>
+  void releaseObject(Pool& pool, std::vector<T>& destination, T object) {
+    if (pool.stats.live == 0) {
+      throw std::runtime_error("Released a sync object that was not acquired from the pool");
+    }
+#ifndef NDEBUG
+    if (pool.acquired.erase(object) == 0) {
+      throw std::runtime_error("Released a sync object twice or one from another pool");
+    }
+#endif
+
+    pool.stats.live--;
+    destination.push_back(object);
+  }
+
+  template <typename Pool>
+  void reportLeaks(const Pool& pool, const char* what) {
+    if (pool.stats.live > 0) {
+      std::cerr << "SyncPool: " << pool.stats.live << " " << what << " still acquired at device teardown" << std::endl;
+    }
+  }
+} // namespace
+
+
+SyncPool::SyncPool(Device* device)
+  : device(device)
+{
+}
+
+SyncPool::~SyncPool() {
+  reportLeaks(fences, "fence(s)");
+  reportLeaks(semaphores, "semaphore(s)");
+  reportLeaks(events, "event(s)");
+
+  // Leaked objects are destroyed too, the device is going away regardless
+  VkDevice vkDevice = device->GetVkDevice();
+  for (VkFence fence : fences.objects)
+  {
+    vkDestroyFence(vkDevice, fence, nullptr);
+  }
+  for (VkSemaphore semaphore : semaphores.objects)
+  {
+    vkDestroySemaphore(vkDevice, semaphore, nullptr);
+  }
+  for (VkEvent event : events.objects)
+  {
+    vkDestroyEvent(vkDevice, event, nullptr);
+  }
+}
+
+template <typename T>
+SyncObjectStats SyncPool::getStats(const ObjectPool<T>& pool) const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  SyncObjectStats stats = pool.stats;
+  stats.available = pool.available.size() + pool.pendingReset.size();
+  return stats;
+}
+
+VkFence SyncPool::AcquireFence() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (fences.available.empty() && !fences.pendingReset.empty()) {
+    resetFences();
+  }
+
+  return acquireObject(fences, [this]() {
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    if (vkCreateFence(device->GetVkDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create fence");
+    }
+    return fence;
+  });
+}
+
+void SyncPool::ReleaseFence(VkFence fence) {
+  std::lock_guard<std::mutex> lock(mutex);
+  releaseObject(fences, fences.pendingReset, fence);
+}
+
+VkSemaphore SyncPool::AcquireSemaphore() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  return acquireObject(semaphores, [this]() {
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(device->GetVkDevice(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create semaphore");
+    }
+    return semaphore;
+  });
+}
+
+void SyncPool::ReleaseSemaphore(VkSemaphore semaphore) {
+  std::lock_guard<std::mutex> lock(mutex);
+  // Binary semaphores are unsignaled once waited on, nothing to reset
+  releaseObject(semaphores, semaphores.available, semaphore);
+}
+
+VkEvent SyncPool::AcquireEvent() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (events.available.empty() && !events.pendingReset.empty()) {
+    resetEvents();
+  }
+
+  return acquireObject(events, [this]() {
+    VkEventCreateInfo eventInfo = {};
+    eventInfo.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
+
+    VkEvent event;
+    if (vkCreateEvent(device->GetVkDevice(), &eventInfo, nullptr, &event) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to create event");
+    }
+    return event;
+  });
+}
+
+void SyncPool::ReleaseEvent(VkEvent event) {
+  std::lock_guard<std::mutex> lock(mutex);
+  releaseObject(events, events.pendingReset, event);
+}
+
+void SyncPool::Recycle() {
+  std::lock_guard<std::mutex> lock(mutex);
+  resetFences();
+  resetEvents();
+}
+
+SyncObjectStats SyncPool::GetFenceStats() const {
+  return getStats(fences);
+}
+
+SyncObjectStats SyncPool::GetSemaphoreStats() const {
+  return getStats(semaphores);
+}
+
+SyncObjectStats SyncPool::GetEventStats() const {
+  return getStats(events);
+}
+
+void SyncPool::resetFences() {
+  if (fences.pendingReset.empty()) {
+    return;
+  }
+
+  // One call for the whole batch
+  if (vkResetFences(device->GetVkDevice(), static_cast<uint32_t>(fences.pendingReset.size()), fences.pendingReset.data()) != VK_SUCCESS) {
+    throw std::runtime_error("Failed to reset fences");
+  }
+
+  fences.available.insert(fences.available.end(), fences.pendingReset.begin(), fences.pendingReset.end());
+  fences.pendingReset.clear();
+}
+
+void SyncPool::resetEvents() {
+  // There is no bulk reset for events, but batching still keeps it off the acquire path
+  for (VkEvent event : events.pendingReset)
+  {
+    if (vkResetEvent(device->GetVkDevice(), event) != VK_SUCCESS) {
+      throw std::runtime_error("Failed to reset event");
+    }
+  }
+
+  events.available.insert(events.available.end(), events.pendingReset.begin(), events.pendingReset.end());
+  events.pendingReset.clear();
+}
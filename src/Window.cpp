@@ -1,41 +1,76 @@
 #include <stdexcept>
+#include <vector>
 
 #include "Window.h"
 
 namespace 
 {
-  GLFWwindow* window = nullptr;
+  // The first window is the one created by InitializeWindow
+  std::vector<GLFWwindow*> windows;
 } // namespace 
 
 GLFWwindow* GetGLFWWindow() {
-  return window;
+  return windows.empty() ? nullptr : windows.front();
 }
 
-void InitializeWindow(int width, int height, const char* title) {
+void InitializeGLFW() {
   if (!glfwInit())
   {
-    std::runtime_error("Failed to initialize glfw");
+    throw std::runtime_error("Failed to initialize glfw");
   }
 
   if (!glfwVulkanSupported())
   {
-    std::runtime_error("Do not support Vulkan");
+    throw std::runtime_error("Do not support Vulkan");
   }
+}
 
+void InitializeWindow(int width, int height, const char* title) {
+  InitializeGLFW();
+  CreateGLFWWindow(width, height, title);
+}
+
+GLFWwindow* CreateGLFWWindow(int width, int height, const char* title) {
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+  GLFWwindow* window = glfwCreateWindow(width, height, title, nullptr, nullptr);
 
   if (!window) {
-    std::runtime_error("Failed to create GLFW window");
+    throw std::runtime_error("Failed to create GLFW window");
   }
 
+  windows.push_back(window);
+  return window;
 }
 
 bool ShouldQuit() {
+  return ShouldClose(GetGLFWWindow());
+}
+
+bool ShouldClose(GLFWwindow* window) {
   return !!glfwWindowShouldClose(window);
 }
 
+bool IsMinimized() {
+  return IsMinimized(GetGLFWWindow());
+}
+
+bool IsMinimized(GLFWwindow* window) {
+  if (glfwGetWindowAttrib(window, GLFW_ICONIFIED)) {
+    return true;
+  }
+
+  // Some platforms report a zero sized framebuffer instead of iconifying
+  int width = 0, height = 0;
+  glfwGetFramebufferSize(window, &width, &height);
+  return width == 0 || height == 0;
+}
+
 void DestroyWindow() {
-  glfwDestroyWindow(window);
+  for (GLFWwindow* window : windows)
+  {
+    glfwDestroyWindow(window);
+  }
+  windows.clear();
+
   glfwTerminate();
 }